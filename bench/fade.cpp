@@ -0,0 +1,175 @@
+#include <vector>
+#include "main.h"
+
+static void
+fade_screen(WINDOW* w){
+  for(int i = 0 ; i < COLORS && i < 256 ; ++i){
+    int pair = i;
+    wattr_set(w, A_NORMAL, 0, &pair);
+    mvwaddch(w, i / 64, i % 64, '*');
+  }
+  wrefresh(w);
+}
+
+// The per-frame work of a fade over count colors: rewrite count palette
+// entries, and refresh the screen.
+static void BM_FadeFrame(benchmark::State& state, bool headless){
+  WINDOW* w = headless ? outcurses_init_headless(nullptr, 24, 80)
+                       : outcurses_init(true);
+  if(w == nullptr){
+    state.SkipWithError("Couldn't initialize outcurses");
+    return;
+  }
+  const int count = state.range(0);
+  if(count > COLORS){
+    state.SkipWithError("Terminal has too few colors");
+    outcurses_stop(true);
+    return;
+  }
+  fade_screen(stdscr);
+  std::vector<outcurses_rgb> palette(count);
+  retrieve_palette(count, palette.data(), nullptr, false);
+  int frame = 0;
+  if(headless){
+    outcurses_headless_sample(nullptr);
+  }
+  for(auto _ : state){
+    std::vector<outcurses_rgb> cur(palette);
+    for(auto& c : cur){ // halve and restore, so that every color changes
+      if(frame % 2){
+        c.r /= 2; c.g /= 2; c.b /= 2;
+      }
+    }
+    set_palette(count, cur.data());
+    wrefresh(stdscr);
+    ++frame;
+  }
+  if(headless){
+    report_termstats(state);
+  }
+  set_palette(count, palette.data());
+  state.SetItemsProcessed(state.iterations() * count);
+  outcurses_stop(true);
+}
+BENCHMARK_CAPTURE(BM_FadeFrame, tty, false)->Arg(8)->Arg(16)->Arg(88)
+  ->Arg(256)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_FadeFrame, headless, true)->Arg(8)->Arg(16)->Arg(88)
+  ->Arg(256)->Unit(benchmark::kMicrosecond);
+
+// Accumulate the most recent fade's statistics into counters.
+static void
+add_fade_stats(benchmark::State& state){
+  outcurses_fade_stats stats;
+  if(outcurses_last_fade_stats(&stats) == 0){
+    state.counters["frames"] += stats.frames;
+    state.counters["skipped"] += stats.dropped + stats.missed;
+    state.counters["overrun_us"] += stats.overrun_ns / 1000.0;
+  }
+}
+
+static void
+average_fade_stats(benchmark::State& state){
+  for(const char* c : { "frames", "skipped", "overrun_us", }){
+    state.counters[c] = benchmark::Counter(state.counters[c],
+                          benchmark::Counter::kAvgIterations);
+  }
+}
+
+// Complete fades of range(0) milliseconds. Ideally, each iteration takes
+// exactly that long; anything more is overrun.
+static void BM_FadeOut(benchmark::State& state){
+  if(outcurses_init(true) == nullptr){
+    state.SkipWithError("Couldn't initialize outcurses");
+    return;
+  }
+  fade_screen(stdscr);
+  for(auto _ : state){
+    if(fadeout(stdscr, state.range(0))){
+      state.SkipWithError("Error fading out");
+      break;
+    }
+    add_fade_stats(state);
+  }
+  average_fade_stats(state);
+  outcurses_stop(true);
+}
+BENCHMARK(BM_FadeOut)->Arg(1)->Arg(10)->Unit(benchmark::kMillisecond);
+
+static void BM_FadeIn(benchmark::State& state){
+  if(outcurses_init(true) == nullptr){
+    state.SkipWithError("Couldn't initialize outcurses");
+    return;
+  }
+  std::vector<outcurses_rgb> palette(COLORS);
+  fade_screen(stdscr);
+  for(auto _ : state){
+    if(retrieve_palette(COLORS, palette.data(), nullptr, true)){
+      state.SkipWithError("Error retrieving palette");
+      break;
+    }
+    if(fadein(stdscr, COLORS, palette.data(), state.range(0))){
+      state.SkipWithError("Error fading in");
+      break;
+    }
+    add_fade_stats(state);
+  }
+  average_fade_stats(state);
+  outcurses_stop(true);
+}
+BENCHMARK(BM_FadeIn)->Arg(1)->Arg(10)->Unit(benchmark::kMillisecond);
+
+// Complete 10ms fades there and back, in which only range(0) of the palette's
+// colors change, as seen by the headless emulator. Escapes ought scale with
+// the changing colors, not the palette.
+static void BM_FadeToSparse(benchmark::State& state){
+  if(outcurses_init_headless(nullptr, 24, 80) == nullptr){
+    state.SkipWithError("Couldn't initialize outcurses");
+    return;
+  }
+  const int changing = state.range(0);
+  if(changing > COLORS){
+    state.SkipWithError("Terminal has too few colors");
+    outcurses_stop(true);
+    return;
+  }
+  fade_screen(stdscr);
+  std::vector<outcurses_rgb> palette(COLORS);
+  retrieve_palette(COLORS, palette.data(), nullptr, false);
+  std::vector<outcurses_rgb> to(palette);
+  for(int i = 0 ; i < changing ; ++i){
+    to[i * (COLORS / changing)].r = 1000 - to[i * (COLORS / changing)].r;
+  }
+  outcurses_headless_sample(nullptr);
+  for(auto _ : state){
+    if(fadeto(stdscr, COLORS, palette.data(), to.data(), 10) ||
+       fadeto(stdscr, COLORS, to.data(), palette.data(), 10)){
+      state.SkipWithError("Error fading");
+      break;
+    }
+  }
+  report_termstats(state);
+  set_palette(COLORS, palette.data());
+  outcurses_stop(true);
+}
+BENCHMARK(BM_FadeToSparse)->Arg(1)->Arg(16)->Arg(256)
+  ->Unit(benchmark::kMillisecond);
+
+// Retrieving the entire palette, as every fade does. After the first, this is
+// served from the shadow palette.
+static void BM_RetrievePalette(benchmark::State& state){
+  if(outcurses_init_headless(nullptr, 24, 80) == nullptr){
+    state.SkipWithError("Couldn't initialize outcurses");
+    return;
+  }
+  std::vector<outcurses_rgb> palette(COLORS);
+  for(auto _ : state){
+    if(retrieve_palette(COLORS, palette.data(), nullptr, false)){
+      state.SkipWithError("Error retrieving palette");
+      break;
+    }
+    benchmark::DoNotOptimize(palette.data());
+  }
+  state.SetItemsProcessed(state.iterations() * COLORS);
+  outcurses_stop(true);
+}
+BENCHMARK(BM_RetrievePalette)->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,47 @@
+#include <fcntl.h>
+#include <clocale>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+#include "main.h"
+
+// ncurses writes to stdout and complains to stderr, but stdout is where our
+// results go. Hold on to the real stdout and stderr, and point ncurses at
+// /dev/null. Results are always written as JSON, in addition to any file
+// requested via --benchmark_out.
+int main(int argc, char** argv){
+  if(!setlocale(LC_ALL, "")){
+    std::cerr << "Couldn't set locale based on user preferences!" << std::endl;
+    return EXIT_FAILURE;
+  }
+  // the output is discarded, so it needn't match the actual terminal. use a
+  // capable one by default, so that the fades can be measured. set
+  // OUTCURSES_BENCH_TERM to measure against some other terminfo entry.
+  const char* term = getenv("OUTCURSES_BENCH_TERM");
+  setenv("TERM", term ? term : "xterm-256color", 1);
+  ::benchmark::Initialize(&argc, argv);
+  if(::benchmark::ReportUnrecognizedArguments(argc, argv)){
+    return EXIT_FAILURE;
+  }
+  int resfd = dup(STDOUT_FILENO);
+  int errfd = dup(STDERR_FILENO);
+  int nullfd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+  if(resfd < 0 || errfd < 0 || nullfd < 0){
+    std::cerr << "Couldn't set up output descriptors" << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::ofstream results("/dev/fd/" + std::to_string(resfd));
+  std::ofstream errors("/dev/fd/" + std::to_string(errfd));
+  if(dup2(nullfd, STDOUT_FILENO) < 0 || dup2(nullfd, STDERR_FILENO) < 0){
+    std::cerr << "Couldn't redirect ncurses output" << std::endl;
+    return EXIT_FAILURE;
+  }
+  close(nullfd);
+  ::benchmark::JSONReporter reporter;
+  reporter.SetOutputStream(&results);
+  reporter.SetErrorStream(&errors);
+  ::benchmark::RunSpecifiedBenchmarks(&reporter);
+  ::benchmark::Shutdown();
+  return EXIT_SUCCESS;
+}
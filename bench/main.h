@@ -0,0 +1,22 @@
+#ifndef OUTCURSES_BENCH_MAIN
+#define OUTCURSES_BENCH_MAIN
+
+#include <benchmark/benchmark.h>
+#include <outcurses.h>
+
+// Report terminal-side costs per iteration, as seen by the headless emulator
+// since the previous sample. Sample once before the timed loop to reset.
+static inline void
+report_termstats(benchmark::State& state){
+  outcurses_termstats stats;
+  if(outcurses_headless_sample(&stats)){
+    state.SkipWithError("Couldn't sample headless terminal");
+    return;
+  }
+  const auto avg = benchmark::Counter::kAvgIterations;
+  state.counters["bytes"] = benchmark::Counter(stats.bytes, avg);
+  state.counters["escapes"] = benchmark::Counter(stats.escapes, avg);
+  state.counters["cells"] = benchmark::Counter(stats.cells_changed, avg);
+}
+
+#endif
@@ -0,0 +1,13 @@
+#include "main.h"
+
+// Startup cost, dominated by prep_colors().
+static void BM_Init(benchmark::State& state){
+  for(auto _ : state){
+    if(outcurses_init(true) == nullptr){
+      state.SkipWithError("Couldn't initialize outcurses");
+      break;
+    }
+    outcurses_stop(true);
+  }
+}
+BENCHMARK(BM_Init)->Unit(benchmark::kMicrosecond);
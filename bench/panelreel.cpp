@@ -0,0 +1,259 @@
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <vector>
+#include "main.h"
+
+// Fill as many lines as the tablet has (the curry), up to the space offered.
+static int
+benchcb(struct tablet* t, int begx, int begy, int maxx, int maxy, bool cliptop){
+  (void)cliptop;
+  WINDOW* w = panel_window(tablet_panel(t));
+  int lines = static_cast<int>(reinterpret_cast<intptr_t>(tablet_userptr(t)));
+  int y;
+  for(y = begy ; y <= maxy && y - begy < lines ; ++y){
+    wmove(w, y, begx);
+    int x;
+    for(x = begx ; x <= maxx ; ++x){
+      waddch(w, 'a' + (y + x) % 26);
+    }
+  }
+  return y - begy;
+}
+
+// The lines benchcb() will fill, given enough space.
+static int
+benchmeasure(struct tablet* t, int cols){
+  (void)cols;
+  return static_cast<int>(reinterpret_cast<intptr_t>(tablet_userptr(t)));
+}
+
+static struct panelreel*
+bench_reel(int efd){
+  panelreel_options popts{};
+  popts.infinitescroll = true;
+  popts.circular = true;
+  popts.tabletpair = COLOR_GREEN;
+  popts.focusedpair = COLOR_CYAN;
+  return panelreel_create(stdscr, &popts, efd);
+}
+
+static void*
+tablet_lines(int64_t idx){
+  return reinterpret_cast<void*>(static_cast<intptr_t>(idx % 7 + 1));
+}
+
+// Add N tablets to an empty reel, and tear it down.
+static void BM_PanelreelAdd(benchmark::State& state){
+  if(outcurses_init(true) == nullptr){
+    state.SkipWithError("Couldn't initialize outcurses");
+    return;
+  }
+  for(auto _ : state){
+    struct panelreel* pr = bench_reel(-1);
+    if(pr == nullptr){
+      state.SkipWithError("Couldn't create panelreel");
+      break;
+    }
+    for(int64_t i = 0 ; i < state.range(0) ; ++i){
+      panelreel_add(pr, nullptr, nullptr, benchcb, tablet_lines(i));
+    }
+    panelreel_destroy(pr);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  outcurses_stop(true);
+}
+BENCHMARK(BM_PanelreelAdd)->RangeMultiplier(4)->Range(1, 1024)
+  ->Unit(benchmark::kMicrosecond);
+
+// Load N tablets into an empty reel in one batch, and tear it down.
+static void BM_PanelreelAddMany(benchmark::State& state){
+  if(outcurses_init(true) == nullptr){
+    state.SkipWithError("Couldn't initialize outcurses");
+    return;
+  }
+  std::vector<void*> opaques;
+  for(int64_t i = 0 ; i < state.range(0) ; ++i){
+    opaques.push_back(tablet_lines(i));
+  }
+  for(auto _ : state){
+    struct panelreel* pr = bench_reel(-1);
+    if(pr == nullptr){
+      state.SkipWithError("Couldn't create panelreel");
+      break;
+    }
+    panelreel_add_many(pr, nullptr, nullptr, benchcb, opaques.data(),
+                       static_cast<int>(opaques.size()), nullptr);
+    panelreel_destroy(pr);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  outcurses_stop(true);
+}
+BENCHMARK(BM_PanelreelAddMany)->RangeMultiplier(8)->Range(1, 32768)
+  ->Unit(benchmark::kMicrosecond);
+
+// Cost of a single step (and thus full redraw) through a reel of N tablets.
+// The headless variants additionally count what reached the terminal. The
+// measured variant lays out before drawing.
+static void BM_PanelreelNavigate(benchmark::State& state, bool next,
+                                 bool headless, bool measured){
+  WINDOW* w = headless ? outcurses_init_headless(nullptr, 50, 80)
+                       : outcurses_init(true);
+  if(w == nullptr){
+    state.SkipWithError("Couldn't initialize outcurses");
+    return;
+  }
+  struct panelreel* pr = bench_reel(-1);
+  if(pr == nullptr){
+    state.SkipWithError("Couldn't create panelreel");
+    outcurses_stop(true);
+    return;
+  }
+  for(int64_t i = 0 ; i < state.range(0) ; ++i){
+    struct tablet* t = panelreel_add(pr, nullptr, nullptr, benchcb,
+                                     tablet_lines(i));
+    if(measured){
+      panelreel_set_measurecb(pr, t, benchmeasure);
+      panelreel_update(pr);
+    }
+  }
+  if(headless){
+    outcurses_headless_sample(nullptr);
+  }
+  for(auto _ : state){
+    benchmark::DoNotOptimize(next ? panelreel_next(pr) : panelreel_prev(pr));
+  }
+  if(headless){
+    report_termstats(state);
+  }
+  panelreel_destroy(pr);
+  outcurses_stop(true);
+}
+BENCHMARK_CAPTURE(BM_PanelreelNavigate, next, true, false, false)
+  ->RangeMultiplier(8)->Range(1, 4096)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_PanelreelNavigate, prev, false, false, false)
+  ->RangeMultiplier(8)->Range(1, 4096)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_PanelreelNavigate, next_headless, true, true, false)
+  ->RangeMultiplier(8)->Range(1, 4096)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_PanelreelNavigate, next_measured, true, true, true)
+  ->RangeMultiplier(8)->Range(1, 4096)->Unit(benchmark::kMicrosecond);
+
+// Occupies as many lines as benchcb() would, but draws nothing.
+static int
+blankcb(struct tablet* t, int begx, int begy, int maxx, int maxy, bool cliptop){
+  (void)begx;
+  (void)maxx;
+  (void)cliptop;
+  int lines = static_cast<int>(reinterpret_cast<intptr_t>(tablet_userptr(t)));
+  return maxy - begy + 1 < lines ? maxy - begy + 1 : lines;
+}
+
+// Full redraw of a screenful of blank tablets, N columns wide. Tablet borders
+// are most of what's drawn.
+static void BM_PanelreelRedrawBorders(benchmark::State& state){
+  if(outcurses_init_headless(nullptr, 50, state.range(0)) == nullptr){
+    state.SkipWithError("Couldn't initialize outcurses");
+    return;
+  }
+  struct panelreel* pr = bench_reel(-1);
+  if(pr == nullptr){
+    state.SkipWithError("Couldn't create panelreel");
+    outcurses_stop(true);
+    return;
+  }
+  for(int i = 0 ; i < 20 ; ++i){
+    panelreel_add(pr, nullptr, nullptr, blankcb, tablet_lines(i));
+  }
+  outcurses_headless_sample(nullptr);
+  for(auto _ : state){
+    panelreel_redraw(pr);
+  }
+  report_termstats(state);
+  panelreel_destroy(pr);
+  outcurses_stop(true);
+}
+BENCHMARK(BM_PanelreelRedrawBorders)->Arg(80)->Arg(240)->Arg(480)
+  ->Unit(benchmark::kMicrosecond);
+
+// Throughput of panelreel_touch() against a reel signaling an eventfd.
+static void BM_PanelreelTouch(benchmark::State& state){
+  if(outcurses_init(true) == nullptr){
+    state.SkipWithError("Couldn't initialize outcurses");
+    return;
+  }
+  int efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  struct panelreel* pr = bench_reel(efd);
+  if(efd < 0 || pr == nullptr){
+    state.SkipWithError("Couldn't create panelreel");
+    outcurses_stop(true);
+    return;
+  }
+  struct tablet* t = panelreel_add(pr, nullptr, nullptr, benchcb, tablet_lines(0));
+  for(auto _ : state){
+    panelreel_touch(pr, t);
+  }
+  state.SetItemsProcessed(state.iterations());
+  uint64_t val;
+  benchmark::DoNotOptimize(read(efd, &val, sizeof(val)));
+  panelreel_destroy(pr);
+  close(efd);
+  outcurses_stop(true);
+}
+BENCHMARK(BM_PanelreelTouch);
+
+// Touch the focused tablet of a reel of N tablets, and update the display.
+// Only the touched tablet ought be redrawn.
+static void BM_PanelreelUpdate(benchmark::State& state){
+  if(outcurses_init_headless(nullptr, 50, 80) == nullptr){
+    state.SkipWithError("Couldn't initialize outcurses");
+    return;
+  }
+  struct panelreel* pr = bench_reel(-1);
+  if(pr == nullptr){
+    state.SkipWithError("Couldn't create panelreel");
+    outcurses_stop(true);
+    return;
+  }
+  for(int64_t i = 0 ; i < state.range(0) ; ++i){
+    panelreel_add(pr, nullptr, nullptr, benchcb, tablet_lines(i));
+  }
+  struct tablet* t = panelreel_focused(pr);
+  outcurses_headless_sample(nullptr);
+  for(auto _ : state){
+    panelreel_touch(pr, t);
+    panelreel_update(pr);
+  }
+  report_termstats(state);
+  panelreel_destroy(pr);
+  outcurses_stop(true);
+}
+BENCHMARK(BM_PanelreelUpdate)->RangeMultiplier(8)->Range(1, 512)
+  ->Unit(benchmark::kMicrosecond);
+
+// Jump among N tablets. The cost ought be independent of N.
+static void BM_PanelreelFocusIndex(benchmark::State& state){
+  if(outcurses_init_headless(nullptr, 50, 80) == nullptr){
+    state.SkipWithError("Couldn't initialize outcurses");
+    return;
+  }
+  struct panelreel* pr = bench_reel(-1);
+  if(pr == nullptr){
+    state.SkipWithError("Couldn't create panelreel");
+    outcurses_stop(true);
+    return;
+  }
+  const int count = static_cast<int>(state.range(0));
+  for(int i = 0 ; i < count ; ++i){
+    panelreel_add(pr, nullptr, nullptr, benchcb, tablet_lines(i));
+  }
+  unsigned idx = 0;
+  outcurses_headless_sample(nullptr);
+  for(auto _ : state){
+    idx = idx * 1103515245u + 12345u;
+    panelreel_focus_index(pr, idx % count);
+  }
+  report_termstats(state);
+  panelreel_destroy(pr);
+  outcurses_stop(true);
+}
+BENCHMARK(BM_PanelreelFocusIndex)->RangeMultiplier(16)->Range(16, 65536)
+  ->Unit(benchmark::kMicrosecond);
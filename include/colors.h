@@ -10,6 +10,22 @@ extern "C" {
 
 int prep_colors(void);
 
+// reinitialize all fixed and currently-hashed pairs, i.e. after an
+// reset_color_pairs(). returns non-zero if any pair failed.
+int reprep_pairs(void);
+
+// release all colorpair allocator state.
+void stop_colors(void);
+
+// The shadow palette. palette_color() answers from the shadow where possible,
+// querying (and remembering) the color otherwise. palette_set() writes the
+// color only if it differs from the shadow. Both return non-zero on failure.
+int palette_color(int color, outcurses_rgb* rgb);
+int palette_set(int color, const outcurses_rgb* rgb);
+
+// forget the shadow palette, i.e. when (re)starting color.
+void clear_palette(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,33 @@
+#ifndef OUTCURSES_HEADLESS
+#define OUTCURSES_HEADLESS
+
+// internal header for headless mode. these symbols will not be exported to the
+// final library, and this header will not be installed.
+
+#include <ncurses.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// create a pty sized rows x cols, start the emulator thread, and newterm()
+// termtype (TERM, or xterm-256color if unset, when NULL) atop it. returns the
+// new SCREEN, which is current, or NULL on failure.
+SCREEN* headless_start(const char* termtype, int rows, int cols);
+
+// is a headless screen active?
+bool headless_active(void);
+
+// ncurses' end of the pty, or -1 if no headless screen is active.
+int headless_fd(void);
+
+// endwin() if necessary, restore any previous screen, and tear down the pty
+// and emulator. a no-op if no headless screen is active.
+int headless_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef OUTCURSES_ISEQ
+#define OUTCURSES_ISEQ
+
+// internal header for indexed sequences. these symbols will not be exported to
+// the final library, and this header will not be installed.
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// An indexed sequence is an implicit treap: a binary tree ordered by position
+// rather than key, heap-ordered by random priorities, with subtree sizes. It
+// supports insertion, removal, lookup by position, and finding a node's
+// position, all in expected O(log n). Nodes are embedded in their owners.
+typedef struct iseqnode {
+  struct iseqnode* left;
+  struct iseqnode* right;
+  struct iseqnode* parent;
+  unsigned prio;
+  size_t size;           // nodes in this subtree, including this one
+} iseqnode;
+
+typedef struct iseq {
+  iseqnode* root;
+  unsigned seed;         // xorshift state for priorities
+} iseq;
+
+void iseq_init(iseq* s);
+
+// number of nodes in the sequence
+static inline size_t
+iseq_count(const iseq* s){
+  return s->root ? s->root->size : 0;
+}
+
+// insert n such that it is at position idx, which must be no greater than
+// iseq_count(). nodes at idx and beyond move back by one.
+void iseq_insert(iseq* s, iseqnode* n, size_t idx);
+
+// remove n, which must be in s.
+void iseq_remove(iseq* s, iseqnode* n);
+
+// the position of n, which must be in some sequence.
+size_t iseq_index(const iseqnode* n);
+
+// the node at position idx, or NULL if idx is out of range.
+iseqnode* iseq_at(const iseq* s, size_t idx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
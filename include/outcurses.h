@@ -21,31 +21,148 @@ WINDOW* outcurses_init(bool initcurses);
 // restoring the screen and cleaning up ncurses.
 int outcurses_stop(bool stopcurses);
 
+// Initialize the library atop an in-process pseudoterminal of rows x cols,
+// described by the terminfo entry termtype (TERM, or xterm-256color if that is
+// unset, when NULL). Nothing reaches the real terminal; instead, the output is
+// interpreted by a built-in VT emulator, making it possible to measure what
+// each frame costs. Only one headless screen may exist at a time. It is torn
+// down by outcurses_stop(), regardless of stopcurses.
+WINDOW* outcurses_init_headless(const char* termtype, int rows, int cols);
+
+// Terminal-side costs, as seen by the headless emulator.
+typedef struct outcurses_termstats {
+  unsigned long bytes;         // bytes written to the terminal
+  unsigned long escapes;       // escape/control sequences, strings included
+  unsigned long controls;      // C0 control characters (CR, LF, BS...)
+  unsigned long glyphs;        // printed characters, combining ones included
+  unsigned long cells_changed; // cells whose glyph or rendition changed
+} outcurses_termstats;
+
+// Wait for the emulator to consume everything written thus far, and write the
+// counts accumulated since the previous sample (or initialization) to stats,
+// if it is not NULL. The counts are then reset. Returns -1 if no headless
+// screen is active, or if the emulator didn't catch up within a few seconds.
+int outcurses_headless_sample(outcurses_termstats* stats);
+
+// Get the glyph at (y, x) on the emulated screen, as of the most recent
+// sample. The right half of a wide glyph is 0. Returns -1 if no headless screen
+// is active, or if the coordinates are out of bounds.
+int outcurses_headless_cell(int y, int x, wchar_t* wc);
+
+// Acquire an extended color pair having foreground fg and background bg, each
+// either a palette index or -1 for the terminal default. Pairs are set up on
+// first use and shared among all holders of the same combination. Returns -1
+// if the colors are invalid, or if every available pair is referenced. If
+// ncurses was initialized by the application, pairs it sets up itself might
+// be overwritten; use one scheme or the other.
+int outcurses_pair(int fg, int bg);
+
+// Release a reference acquired via outcurses_pair(). Once unreferenced, the
+// pair remains valid until it is recycled for some other combination.
+int outcurses_pair_release(int pair);
+
 // A set of RGB color components
 typedef struct outcurses_rgb {
   int r, g, b;
 } outcurses_rgb;
 
 // Do a palette fade on the specified screen over the course of ms milliseconds.
-// FIXME allow colorpair range to be specified for partial-screen fades
+// See fadeout_region() for partial-screen fades.
 int fadeout(WINDOW* w, unsigned ms);
 
+// Fade out only the colors used within w, restoring the palette afterwards.
+// Palette entries w shares with anything else onscreen are first copied to
+// scratch entries (ones unused onscreen), and w's cells are switched to pairs
+// using them, so that the rest of the screen is unaffected. Should the scratch
+// entries run out, the remaining shared colors are faded in place. w's cells
+// get their original pairs back once the fade completes.
+int fadeout_region(WINDOW* w, unsigned ms);
+
+// Fade the colors used within w in from black, as per fadeout_region(). w
+// ought have been drawn, but not yet refreshed.
+int fadein_region(WINDOW* w, unsigned ms);
+
 // count ought be COLORS to retrieve the entire palette. palette is a
-// count-element array of rgb values. if maxes is non-NULL, it points to a
-// single rgb triad, which will be filled in with the maximum components found.
-// if zeroout is set, the palette will be set to all 0s. to fade in, we
-// generally want to prepare the screen using a zerod-out palette, then
-// initiate the fadein targeting the true palette.
+// count-element array of rgb values. Colors are served from the library's
+// shadow palette where possible, so applications changing the palette ought
+// use outcurses_set_color() or set_palette(), not init_extended_color(). if
+// maxes is non-NULL, it points to a single rgb triad, which will be filled in
+// with the maximum components found. if zeroout is set, the palette will be
+// set to all 0s. to fade in, we generally want to prepare the screen using a
+// zerod-out palette, then initiate the fadein targeting the true palette.
 int retrieve_palette(int count, outcurses_rgb* palette, outcurses_rgb* maxes,
                      bool zeroout);
 
-// fade in to the specified palette
-// FIXME can we not just generalize this plus fadeout to 'fadeto'?
+// Fade the first count palette entries from one palette to another over the
+// course of ms milliseconds, ending on exactly to. If from is NULL, the current
+// palette is used. Colors which are the same in from and to are never written,
+// and the others are only written when they change from one step to the next.
+// Does not restore the palette upon completion.
+int fadeto(WINDOW* w, int count, const outcurses_rgb* from,
+           const outcurses_rgb* to, unsigned ms);
+
+// fade in to the specified palette from black
 int fadein(WINDOW* w, int count, const outcurses_rgb* palette, unsigned ms);
 
+// Begin a fade as per fadeto(), without blocking. The first step is written
+// immediately. Thereafter, the caller polls fade_fd() for readability
+// (alongside its other descriptors), and calls fade_step() when it's readable.
+// Returns NULL on failure.
+struct fade;
+struct fade* fade_start(WINDOW* w, int count, const outcurses_rgb* from,
+                        const outcurses_rgb* to, unsigned ms);
+
+// The timerfd which becomes readable when the fade's next step is due.
+int fade_fd(const struct fade* f);
+
+// Write the step appropriate to the current time. Returns 1 once the fade has
+// reached its destination, after which only fade_destroy() may be called. Else
+// returns 0, or -1 on error.
+int fade_step(struct fade* f);
+
+// Abandon the fade, restoring the palette in use when it was started, and free
+// it.
+int fade_cancel(struct fade* f);
+
+// Free the fade, leaving the palette as it is.
+int fade_destroy(struct fade* f);
+
+#define OUTCURSES_FADE_LATENCY_BUCKETS 16
+
+// How a fade went. Steps are the distinct palettes between the endpoints, of
+// which some are written (frames), some dropped due to a backlogged terminal,
+// and some missed by waking up too late.
+typedef struct outcurses_fade_stats {
+  unsigned steps;             // steps in the fade
+  unsigned frames;            // steps written
+  unsigned dropped;           // steps dropped; the terminal was backlogged
+  unsigned missed;            // steps passed over by late wakeups
+  unsigned late_wakeups;      // wakeups after the following step was due
+  unsigned long colors;       // palette entries written
+  unsigned long palette_ns;   // time spent writing palette entries
+  unsigned long refresh_ns;   // time spent in wrefresh()
+  long overrun_ns;            // completion past the requested duration
+  // frames by latency, from when the step was due until it was written. bucket
+  // 0 is under 2us, bucket i covers [2^i, 2^(i+1))us, and the last bucket
+  // covers everything slower.
+  unsigned latency[OUTCURSES_FADE_LATENCY_BUCKETS];
+} outcurses_fade_stats;
+
+// Retrieve the statistics of the most recent blocking fade (fadeout(),
+// fadein(), fadeto(), or a region fade). Returns -1 if there hasn't been one.
+int outcurses_last_fade_stats(outcurses_fade_stats* stats);
+
+// Retrieve the statistics of a fade begun with fade_start(), thus far.
+void fade_get_stats(const struct fade* f, outcurses_fade_stats* stats);
+
 // Restores a palette through count colors.
 int set_palette(int count, const outcurses_rgb* palette);
 
+// Set a single palette entry, keeping the shadow palette up to date. Colors
+// are only written to the terminal when they'd change. Returns -1 if color
+// is invalid, or the terminal refused it.
+int outcurses_set_color(int color, const outcurses_rgb* rgb);
+
 // A panelreel is an ncurses window devoted to displaying zero or more
 // line-oriented, contained panels between which the user may navigate. If at
 // least one panel exists, there is an active panel. As much of the active
@@ -114,7 +231,11 @@ struct panelreel;
 // panelreel will be clipped on the bottom and right. A minimum number of rows
 // and columns can be enforced via popts. efd, if non-negative, is an eventfd
 // that ought be written to whenever panelreel_touch() updates a tablet (this
-// is useful in the case of nonblocking input).
+// is useful in the case of nonblocking input). Touches are coalesced: efd is
+// only written by the first touch following panelreel_update() or
+// panelreel_drain_touched(), so one of these ought follow each wakeup. It is
+// likewise written when other threads queue adds or deletions. The calling
+// thread owns the reel: it alone may drive ncurses through it.
 struct panelreel* panelreel_create(WINDOW* w, const panelreel_options* popts,
                                    int efd);
 
@@ -136,6 +257,12 @@ struct panelreel* panelreel_create(WINDOW* w, const panelreel_options* popts,
 typedef int (*tabletcb)(struct tablet* t, int begx, int begy,
                         int maxx, int maxy, bool cliptop);
 
+// Tablet measure callback, provided a tablet and the number of columns its
+// draw callback will be offered. Returns the number of lines the tablet would
+// occupy if given unlimited space. The result is cached until the tablet is
+// touched, or the reel's width changes.
+typedef int (*tabletmeasurecb)(struct tablet* t, int cols);
+
 // Add a new tablet to the provided panelreel, having the callback object
 // opaque. Neither, either, or both of after and before may be specified. If
 // neither is specified, the new tablet can be added anywhere on the reel. If
@@ -143,19 +270,107 @@ typedef int (*tabletcb)(struct tablet* t, int begx, int begy,
 // specified tablet. If both are specifid, the tablet will be added to the
 // resulting location, assuming it is valid (after->next == before->prev); if
 // it is not valid, or there is any other error, NULL will be returned.
+//
+// This may be called from any thread. From any thread other than the one which
+// created the reel, the add is only queued (waking efd, if the queue was
+// empty), and applied before that thread's next panelreel_update(),
+// panelreel_redraw(), panelreel_drain_touched(), or panelreel_sched_run(). The
+// returned tablet may be touched or deleted immediately. If after or before
+// has been deleted by the time the add is applied, it is ignored (unless its
+// storage has meanwhile been reused by a tablet on the reel), and if both
+// remain but are no longer adjacent, the tablet is added as if neither had
+// been specified.
 struct tablet* panelreel_add(struct panelreel* pr, struct tablet* after,
                              struct tablet *before, tabletcb cb, void* opaque);
 
-// Return the number of tablets.
+// Add count tablets as if by successive calls to panelreel_add(), having
+// callback object opaques[0] through opaques[count - 1], in that order, at the
+// location specified by after and before. If tablets is not NULL, the new
+// tablets are written to it. The reel is laid out once. Returns the number of
+// tablets added, or -1 if none could be.
+int panelreel_add_many(struct panelreel* pr, struct tablet* after,
+                       struct tablet* before, tabletcb cb,
+                       void* const* opaques, int count,
+                       struct tablet** tablets);
+
+// Delete every tablet, laying out the (empty) reel once. This takes time
+// proportional to the number of visible tablets, plus that needed to free
+// the tablets' memory. No tablet may be touched, added, or deleted
+// concurrently; tablets queued by other threads are discarded.
+int panelreel_clear(struct panelreel* pr);
+
+// Suppress layout and display of the reel until the matching
+// panelreel_commit(), so that a series of operations costs one frame. Batches
+// may be nested; only the outermost commit lays out the reel, and only if
+// something would have. Tablets are assigned PANELs only when laid out, so
+// tablet_panel() might return NULL for a tablet added within a batch.
+int panelreel_begin_batch(struct panelreel* pr);
+
+// End a batch begun by panelreel_begin_batch(). Returns -1 if there's no batch
+// to end.
+int panelreel_commit(struct panelreel* pr);
+
+// A scheduler paces a panelreel's display to at most maxfps frames per second
+// (0 for no limit). While one is attached, operations on the reel only note
+// that it needs be displayed, and arm a timer for the next frame deadline. The
+// caller polls panelreel_sched_fd() for readability (alongside its other
+// descriptors), and calls panelreel_sched_run() when it's readable. Each run
+// performs at most one layout and one doupdate(). The timer is armed only while
+// a frame is pending, so an idle reel causes no wakeups. A reel may have only
+// one scheduler; returns NULL if one is already attached.
+struct panelreel_sched;
+struct panelreel_sched* panelreel_sched_create(struct panelreel* pr,
+                                               unsigned maxfps);
+
+// The timerfd which becomes readable when a frame is due.
+int panelreel_sched_fd(const struct panelreel_sched* s);
+
+// Display the reel, if a frame is pending and due, and disarm the timer.
+// Returns non-zero on failure.
+int panelreel_sched_run(struct panelreel_sched* s);
+
+// Detach and free the scheduler, first displaying any pending frame. The
+// panelreel may be destroyed before its scheduler, which must nonetheless
+// still be destroyed.
+int panelreel_sched_destroy(struct panelreel_sched* s);
+
+// Provide a measure callback for t, or remove it (cb may be NULL), and touch
+// t. When a tablet can be measured, the reel is laid out before it is drawn:
+// its draw callback is offered exactly the rows it will occupy (fewer than
+// measured if it is clipped), and its return value is ignored. Such a tablet's
+// PANEL is never resized or moved after being drawn, and an untouched one is
+// never redrawn merely because it moved. Call this from the thread driving
+// ncurses.
+int panelreel_set_measurecb(struct panelreel* pr, struct tablet* t,
+                            tabletmeasurecb cb);
+
+// Return the number of tablets, not counting adds queued by other threads.
 int panelreel_tabletcount(const struct panelreel* pr);
 
 // Indicate that the specified tablet has been updated in a way that would
 // change its display. This will trigger some non-negative number of callbacks
-// (though not in the caller's context).
+// (though not in the caller's context), upon the next panelreel_update(). This
+// may be called from any thread, and does not block. A tablet must not be
+// touched concurrently with, or after, its deletion.
 int panelreel_touch(struct panelreel* pr, struct tablet* t);
 
+// Retrieve up to max tablets touched since they were last retrieved (or
+// consumed by panelreel_update()), writing them to out. Each is reported once,
+// no matter how many times it was touched. Returns the number written; if
+// this is max, more might remain. The next panelreel_update() will still
+// invoke the callbacks of those which are visible.
+int panelreel_drain_touched(struct panelreel* pr, struct tablet** out, int max);
+
+// Redraw those visible tablets which have been touched since they were last
+// drawn. Only touched tablets have their callbacks invoked. If a touched
+// tablet changed size, the reel is laid out anew, but untouched tablets are
+// moved rather than redrawn. Does nothing if nothing was touched.
+int panelreel_update(struct panelreel* pr);
+
 // Delete the tablet specified by t from the panelreel specified by pr. Returns
-// -1 if the tablet cannot be found.
+// -1 if the tablet cannot be found, or is already being deleted. From any
+// thread other than the one which created the reel, the deletion is queued
+// like an add from such a thread (see panelreel_add()).
 int panelreel_del(struct panelreel* pr, struct tablet* t);
 
 // Delete the active tablet. Returns -1 if there are no tablets.
@@ -165,9 +380,19 @@ int panelreel_del_focused(struct panelreel* pr);
 int panelreel_move(struct panelreel* pr, int x, int y);
 
 // Redraw the panelreel in its entirety, for instance after
-// clearing the screen due to external corruption, or a SIGWINCH.
+// clearing the screen due to external corruption, or a SIGWINCH. Every
+// visible tablet's callback will be invoked.
 int panelreel_redraw(struct panelreel* pr);
 
+// Fit the panelreel to w, its containing WINDOW, which has changed size (i.e.
+// following KEY_RESIZE). The reel keeps its top and left offsets, including
+// any applied by panelreel_move(), and the bottom and right offsets with which
+// it was created. Tablet windows are resized in place, and only tablets whose
+// width changed have their callbacks invoked. With a scheduler attached, the
+// reel isn't laid out until resizes have stopped arriving for a tenth of a
+// second, so dragging a terminal's edge costs one layout rather than dozens.
+int panelreel_resize(struct panelreel* pr, WINDOW* w);
+
 // Return the focused tablet, if any tablets are present. This is not a copy;
 // be careful to use it only for the duration of a critical section.
 struct tablet* panelreel_focused(struct panelreel* pr);
@@ -178,17 +403,90 @@ struct tablet* panelreel_next(struct panelreel* pr);
 // Change focus to the previous tablet, if one exists
 struct tablet* panelreel_prev(struct panelreel* pr);
 
+// Move the focus by a page. If the focus isn't yet on the last (first)
+// onscreen tablet, it moves there. Otherwise, it moves forward (back) by as
+// many tablets as are onscreen, less one, and that tablet is brought onscreen
+// at the bottom (top). Either way, the reel is laid out once. Returns the
+// newly-focused tablet, or NULL if there are no tablets.
+struct tablet* panelreel_page_down(struct panelreel* pr);
+struct tablet* panelreel_page_up(struct panelreel* pr);
+
+// Change focus to t, which must be on the reel, and lay out the reel once. A
+// neighbor of the focus is reached as if by panelreel_next() or
+// panelreel_prev(); any other is placed at the top, unless every tablet fits.
+// Returns t.
+struct tablet* panelreel_focus(struct panelreel* pr, struct tablet* t);
+
+// Tablets are indexed from 0, in order, starting with the first one added.
+// Each of these takes time logarithmic in the number of tablets, and only
+// visible tablets hold resources beyond their own small allocations.
+
+// Change focus to the tablet at index idx as if by panelreel_focus(),
+// returning it, or NULL if there is no such tablet.
+struct tablet* panelreel_focus_index(struct panelreel* pr, int idx);
+
+// Return the index of the focused tablet, or -1 if there are no tablets.
+int panelreel_focused_index(const struct panelreel* pr);
+
+// Return the tablet at index idx, or NULL if there is no such tablet.
+struct tablet* panelreel_tablet_at(struct panelreel* pr, int idx);
+
 void* tablet_userptr(struct tablet* t);
 const void* tablet_userptr_const(const struct tablet* t);
 PANEL* tablet_panel(struct tablet* t);
 
 // Destroy a panelreel allocated with panelreel_create(). Does not destroy the
-// underlying WINDOW. Returns non-zero on failure.
+// underlying WINDOW, nor draw anything. Returns non-zero on failure.
 int panelreel_destroy(struct panelreel* pr);
 
+// Counters describing how a panelreel has managed its resources, and what its
+// work has cost. Times are in nanoseconds.
+typedef struct panelreel_stats {
+  unsigned long pool_hits;    // tablet PANELs recycled from the pool
+  unsigned long pool_misses;  // tablet PANELs created anew
+  unsigned long slab_hits;    // tablets taken from the free list
+  unsigned long slab_misses;  // tablets requiring a new slab
+  unsigned long arranges;     // layouts of the reel
+  unsigned long frames;       // layouts which were displayed (doupdate()s)
+  unsigned long callbacks;    // tabletcb invocations
+  unsigned long measure_callbacks; // tabletmeasurecb invocations
+  unsigned long touches;      // panelreel_touch() calls
+  unsigned long panels_created;   // newwin() + new_panel() for tablets
+  unsigned long panels_destroyed; // del_panel() + delwin() for tablets
+  unsigned long resizes;      // wresize() of tablet windows
+  unsigned long moves;        // move_panel() of tablet panels
+  unsigned long arrange_ns;   // time spent laying out, callbacks included
+  unsigned long callback_ns;  // time spent in draw and measure callbacks
+  unsigned long doupdate_ns;  // time spent in doupdate()
+  unsigned long window_bytes; // cells currently held by tablet windows
+                              // (pooled ones included), in bytes
+  unsigned long pad_hits;     // offscreen tablets shown anew from their pads
+  unsigned long pad_bytes;    // cells currently held by tablet pads, in bytes
+  unsigned long reel_resizes; // panelreel_resize() calls changing the reel
+} panelreel_stats;
+
+// Retrieve the panelreel's counters, accumulated since its creation or the
+// last panelreel_reset_stats(). This is a copy, and is cheap enough to poll.
+// Only touches are counted atomically; call this from the UI thread.
+void panelreel_get_stats(const struct panelreel* pr, panelreel_stats* stats);
+
+// Zero the panelreel's counters. window_bytes and pad_bytes, being measures of
+// the present rather than accumulations, are retained.
+void panelreel_reset_stats(struct panelreel* pr);
+
 // Verify the panelreel's layout and appearance. Intended for unit testing.
 int panelreel_validate(WINDOW* parent, struct panelreel* pr);
 
+// Write the most recent tracepoints (panelreel layout and tablet drawing, and
+// fade steps) to fp as Chrome trace JSON, loadable by chrome://tracing or
+// Perfetto. Tracepoints are only recorded if Outcurses was built with the
+// OUTCURSES_TRACE option; otherwise, an empty trace is written. Returns the
+// number of events written, or -1 on error.
+int outcurses_trace_dump(FILE* fp);
+
+// Discard all tracepoints recorded thus far.
+void outcurses_trace_clear(void);
+
 #define COLOR_BRIGHTWHITE 16
 
 #ifdef __cplusplus
@@ -0,0 +1,31 @@
+#ifndef OUTCURSES_TRACE_H
+#define OUTCURSES_TRACE_H
+
+// internal header for tracepoints. these symbols will not be exported to the
+// final library, and this header will not be installed.
+//
+// Tracepoints are compiled in only when OUTCURSES_TRACE is defined (see the
+// OUTCURSES_TRACE CMake option). Otherwise, they expand to nothing.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef OUTCURSES_TRACE
+// record an event in the trace ring. name must be a string literal (or
+// otherwise outlive the trace). phase is 'B' to begin a span, or 'E' to end
+// the innermost open span of this thread.
+void trace_event(const char* name, char phase);
+
+#define TRACE_BEGIN(name) trace_event((name), 'B')
+#define TRACE_END(name) trace_event((name), 'E')
+#else
+#define TRACE_BEGIN(name) do{ }while(0)
+#define TRACE_END(name) do{ }while(0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
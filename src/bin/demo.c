@@ -24,11 +24,35 @@ print_intro(WINDOW *w){
 static void
 usage(const char* basename, int status){
   FILE* f = status == EXIT_SUCCESS ? stdout : stderr;
-  fprintf(f, "usage: %s [ -h ]\n", basename);
+  fprintf(f, "usage: %s [ -h ] [ --stress tablets [ --rate touches ] [ --seconds secs ] ]\n", basename);
   fprintf(f, " -h: this message\n");
+  fprintf(f, " --stress: drive this many tablets from a pool of producer threads\n");
+  fprintf(f, " --rate: aggregate touches per second under --stress (default 1000)\n");
+  fprintf(f, " --seconds: duration of --stress (default 10)\n");
   exit(status);
 }
 
+static unsigned
+parse_count(const char* basename, const char* arg){
+  char* end;
+  unsigned long val = strtoul(arg, &end, 10);
+  if(*arg == '\0' || *end || val == 0 || val > 10000000){
+    fprintf(stderr, "Invalid count: %s\n", arg);
+    usage(basename, EXIT_FAILURE);
+  }
+  return val;
+}
+
+static void
+print_stress_report(const stress_report* r){
+  double secs = r->seconds > 0 ? r->seconds : 1;
+  printf("tablets: %d seconds: %.2f\n", r->tablets, r->seconds);
+  printf("touches/s: %.1f frames/s: %.1f callbacks/s: %.1f\n",
+         r->touches / secs, r->frames / secs, r->callbacks / secs);
+  printf("touch-to-frame latency (%lu samples): p50 %.3fms p99 %.3fms\n",
+         r->samples, r->p50_ms, r->p99_ms);
+}
+
 int main(int argc, char** argv){
   WINDOW* w;
 
@@ -36,12 +60,28 @@ int main(int argc, char** argv){
     fprintf(stderr, "Coudln't set locale based on user preferences\n");
     return EXIT_FAILURE;
   }
+  static const struct option longopts[] = {
+    { .name = "stress", .has_arg = required_argument, .flag = NULL, .val = 's', },
+    { .name = "rate", .has_arg = required_argument, .flag = NULL, .val = 'r', },
+    { .name = "seconds", .has_arg = required_argument, .flag = NULL, .val = 'S', },
+    { .name = NULL, .has_arg = 0, .flag = NULL, .val = 0, },
+  };
+  unsigned stress = 0, rate = 1000, seconds = 10;
   int c;
-  while((c = getopt(argc, argv, "h")) != EOF){
+  while((c = getopt_long(argc, argv, "h", longopts, NULL)) != EOF){
     switch(c){
       case 'h':
         usage(*argv, EXIT_SUCCESS);
         break;
+      case 's':
+        stress = parse_count(*argv, optarg);
+        break;
+      case 'r':
+        rate = parse_count(*argv, optarg);
+        break;
+      case 'S':
+        seconds = parse_count(*argv, optarg);
+        break;
       default:
         usage(*argv, EXIT_FAILURE);
         break;
@@ -52,11 +92,21 @@ int main(int argc, char** argv){
     return EXIT_FAILURE;
   }
   int ret = EXIT_SUCCESS;
-  print_intro(w);
-  ret |= panelreel_demo(w);
+  stress_report report;
+  if(stress){
+    if(panelreel_stress(w, stress, rate, seconds, &report)){
+      ret = EXIT_FAILURE;
+    }
+  }else{
+    print_intro(w);
+    ret |= panelreel_demo(w);
+  }
   if(outcurses_stop(true)){
     fprintf(stderr, "Error initializing outcurses\n");
     return EXIT_FAILURE;
+  }
+  if(stress){ // the screen is ours again
+    print_stress_report(&report);
   }
 	return ret;
 }
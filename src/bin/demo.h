@@ -8,9 +8,27 @@ extern "C" {
 #endif
 
 #define FADE_MILLISECONDS 500
+#define DEMO_MAXFPS 60
 
 int panelreel_demo(WINDOW* w);
 
+typedef struct stress_report {
+  int tablets;
+  double seconds;           // time spent under load
+  unsigned long touches;
+  unsigned long frames;
+  unsigned long callbacks;
+  unsigned long samples;    // touches of onscreen tablets which were drawn
+  double p50_ms, p99_ms;    // latency from touch to frame
+} stress_report;
+
+// Drive tablets tablets from a small pool of producer threads, at an
+// aggregate rate touches per second, for seconds seconds (or until q is
+// pressed), navigating the reel by script. The report is filled in even on
+// error, to the degree possible.
+int panelreel_stress(WINDOW* w, int tablets, unsigned rate, unsigned seconds,
+                     stress_report* report);
+
 #ifdef __cplusplus
 }
 #endif
@@ -57,6 +57,13 @@ kill_active_tablet(struct panelreel* pr, tabletctx** tctx){
   return 0;
 }
 
+// outcurses_init() only sets up the first (up to) 256 pairs as the palette
+// atop the default background. Stay within them as we cycle through colors.
+static inline int
+fixed_pair(int cpair){
+  return cpair % (COLORS < 256 ? COLORS : 256);
+}
+
 // We need write in reverse order (since only the bottom will be seen, if we're
 // partially off-screen), but also leave unused space at the end (since
 // wresize() only keeps the top and left on a shrink).
@@ -72,7 +79,7 @@ tabletup(WINDOW* w, int begx, int begy, int maxx, int maxy,
   }
 /*fprintf(stderr, "-OFFSET BY %d (%d->%d)\n", maxy - begy - tctx->lines,
         maxy, maxy - (maxy - begy - tctx->lines));*/
-  for(y = maxy ; y >= begy ; --y, ++cpair){
+  for(y = maxy ; y >= begy ; --y, cpair = fixed_pair(cpair + 1)){
     wmove(w, y, begx);
     swprintf(cchbuf, sizeof(cchbuf) / sizeof(*cchbuf), L"%x", idx % 16);
     setcchar(&cch, cchbuf, A_NORMAL, 0, &cpair);
@@ -95,7 +102,7 @@ tabletdown(WINDOW*w, int begx, int begy, int maxx, int maxy,
   wchar_t cchbuf[2];
   cchar_t cch;
   int y;
-  for(y = begy ; y <= maxy ; ++y, ++cpair){
+  for(y = begy ; y <= maxy ; ++y, cpair = fixed_pair(cpair + 1)){
     if(y - begy >= tctx->lines){
       break;
     }
@@ -186,7 +193,7 @@ new_tabletctx(struct panelreel* pr, unsigned *id){
   pthread_mutex_init(&tctx->lock, NULL);
   tctx->pr = pr;
   tctx->lines = random() % 10 + 1; // FIXME a nice gaussian would be swell
-  tctx->cpair = random() % COLORS;
+  tctx->cpair = fixed_pair(random());
   tctx->id = ++*id;
   if((tctx->t = panelreel_add(pr, NULL, NULL, tabletdraw, tctx)) == NULL){
     pthread_mutex_destroy(&tctx->lock);
@@ -202,18 +209,22 @@ new_tabletctx(struct panelreel* pr, unsigned *id){
 }
 
 static int
-handle_input(WINDOW* w, struct panelreel* pr, int efd, int y, int x){
-  struct pollfd fds[2] = {
+handle_input(WINDOW* w, struct panelreel* pr, struct panelreel_sched* sched,
+             struct fade** fade, int efd, int y, int x){
+  struct pollfd fds[4] = {
     { .fd = STDIN_FILENO, .events = POLLIN, .revents = 0, },
     { .fd = efd,          .events = POLLIN, .revents = 0, },
+    { .fd = panelreel_sched_fd(sched), .events = POLLIN, .revents = 0, },
+    { .fd = -1,           .events = POLLIN, .revents = 0, }, // fade, if any
   };
   int key = -1;
   int pret;
   wrefresh(w);
   do{
+    fds[3].fd = *fade ? fade_fd(*fade) : -1;
     pret = poll(fds, sizeof(fds) / sizeof(*fds), -1);
     if(pret < 0){
-      fprintf(stderr, "Error polling on stdin/eventfd (%s)\n", strerror(errno));
+      fprintf(stderr, "Error polling on stdin/eventfd/timerfd (%s)\n", strerror(errno));
     }else{
       if(fds[0].revents & POLLIN){
         key = mvwgetch(w, y, x);
@@ -223,7 +234,16 @@ handle_input(WINDOW* w, struct panelreel* pr, int efd, int y, int x){
         if(read(efd, &val, sizeof(val)) != sizeof(val)){
           fprintf(stderr, "Error reading from eventfd %d (%s)\n", efd, strerror(errno));
         }else if(key < 0){
-          panelreel_redraw(pr);
+          panelreel_update(pr);
+        }
+      }
+      if(fds[2].revents & POLLIN){
+        panelreel_sched_run(sched);
+      }
+      if(*fade && (fds[3].revents & POLLIN)){
+        if(fade_step(*fade)){ // done (or broken)
+          fade_destroy(*fade);
+          *fade = NULL;
         }
       }
     }
@@ -232,7 +252,7 @@ handle_input(WINDOW* w, struct panelreel* pr, int efd, int y, int x){
 }
 
 static struct panelreel*
-panelreel_demo_core(WINDOW* w, int efd, tabletctx** tctxs){
+panelreel_demo_core(WINDOW* w, int efd, tabletctx** tctxs, struct fade** fade){
   int x = 4, y = 4;
   panelreel_options popts = {
     .infinitescroll = true,
@@ -244,7 +264,7 @@ panelreel_demo_core(WINDOW* w, int efd, tabletctx** tctxs){
     .tabletattr = A_NORMAL,
     .tabletpair = COLOR_GREEN,
     .focusedattr = A_NORMAL,
-    .focusedpair = (COLORS * (COLOR_CYAN + 1)) + 1,
+    .focusedpair = outcurses_pair(COLOR_RED, COLOR_CYAN),
     .toff = y,
     .loff = x,
     .roff = 0,
@@ -255,6 +275,14 @@ panelreel_demo_core(WINDOW* w, int efd, tabletctx** tctxs){
     fprintf(stderr, "Error creating panelreel\n");
     return NULL;
   }
+  // the tablet threads can touch their tablets far more often than is worth
+  // displaying, so cap the frame rate.
+  struct panelreel_sched* sched = panelreel_sched_create(pr, DEMO_MAXFPS);
+  if(sched == NULL){
+    fprintf(stderr, "Error creating panelreel scheduler\n");
+    panelreel_destroy(pr);
+    return NULL;
+  }
   // Press a for a new panel above the current, c for a new one below the
   // current, and b for a new block at arbitrary placement. q quits.
   int pair = COLOR_CYAN;
@@ -271,7 +299,7 @@ panelreel_demo_core(WINDOW* w, int efd, tabletctx** tctxs){
     wclrtoeol(w);
     pair = COLOR_BLUE;
     wattr_set(w, A_NORMAL, 0, &pair);
-    key = handle_input(w, pr, efd, 3, 2);
+    key = handle_input(w, pr, sched, fade, efd, 3, 2);
     clrtoeol();
     struct tabletctx* newtablet = NULL;
     switch(key){
@@ -287,7 +315,14 @@ panelreel_demo_core(WINDOW* w, int efd, tabletctx** tctxs){
       case 'k': panelreel_prev(pr); break;
       case KEY_DOWN:
       case 'j': panelreel_next(pr); break;
+      case KEY_PPAGE: panelreel_page_up(pr); break;
+      case KEY_NPAGE: panelreel_page_down(pr); break;
+      case KEY_HOME: panelreel_focus_index(pr, 0); break;
+      case KEY_END:
+        panelreel_focus_index(pr, panelreel_tabletcount(pr) - 1);
+        break;
       case KEY_DC: kill_active_tablet(pr, tctxs); break;
+      case KEY_RESIZE: panelreel_resize(pr, w); break;
       case 'q': break;
       default: mvwprintw(w, 3, 2, "Unknown keycode (%d)\n", key);
     }
@@ -297,6 +332,7 @@ panelreel_demo_core(WINDOW* w, int efd, tabletctx** tctxs){
     }
     //panelreel_validate(w, pr); // do what, if not assert()ing? FIXME
   }while(key != 'q');
+  panelreel_sched_destroy(sched);
   return pr;
 }
 
@@ -307,8 +343,21 @@ int panelreel_demo(WINDOW* w){
     fprintf(stderr, "Error creating eventfd (%s)\n", strerror(errno));
     return -1;
   }
-  struct panelreel* pr;
-  if((pr = panelreel_demo_core(w, efd, &tctxs)) == NULL){
+  // fade in from black, without holding up input
+  struct fade* fade = NULL;
+  outcurses_rgb* palette = malloc(sizeof(*palette) * COLORS);
+  if(palette && retrieve_palette(COLORS, palette, NULL, true) == 0){
+    if((fade = fade_start(w, COLORS, NULL, palette, FADE_MILLISECONDS)) == NULL){
+      set_palette(COLORS, palette);
+    }
+  }
+  struct panelreel* pr = panelreel_demo_core(w, efd, &tctxs, &fade);
+  if(fade){ // quit before the fade completed
+    fade_destroy(fade);
+    set_palette(COLORS, palette);
+  }
+  free(palette);
+  if(pr == NULL){
     close(efd);
     return -1;
   }
@@ -0,0 +1,359 @@
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/poll.h>
+#include <outcurses.h>
+#include <sys/eventfd.h>
+#include "demo.h"
+
+// Load generator: many tablets, touched by a small fixed pool of producer
+// threads at a fixed aggregate rate, while the reel is navigated according to
+// a script. Latency runs from the first touch of an onscreen tablet until the
+// frame containing its redraw has been written.
+
+#define STRESS_PRODUCERS 4
+#define STRESS_NAV_MS 250
+#define STRESS_MAXLINES 8
+#define NANOSECS_IN_SEC 1000000000ull
+#define NANOSECS_IN_MS 1000000ull
+
+// Navigation script, one step per STRESS_NAV_MS, repeated: j/k move to the
+// next/previous tablet, N/P page down/up, H/E go home/to the end, and r
+// focuses a (deterministically) random tablet.
+static const char NAVSCRIPT[] = "jjjjjNNkkkPjjjjjjjjrjjNkkkkHjjjNNNENPPr";
+
+struct stressctx;
+
+typedef struct stresstablet {
+  struct stressctx* sctx;
+  struct tablet* t;
+  atomic_int lines;
+  atomic_ullong touchns;    // first touch since it was last drawn, or 0
+  unsigned id;
+} stresstablet;
+
+typedef struct stressctx {
+  struct panelreel* pr;
+  stresstablet* tablets;
+  int count;
+  uint64_t intervalns;      // between touches, per producer
+  atomic_bool stop;
+  // touch times of the tablets drawn since the last frame
+  uint64_t* drawn;
+  unsigned long drawncount, drawnalloc;
+  // touch-to-frame latencies
+  uint64_t* samples;
+  unsigned long samplecount, samplealloc;
+} stressctx;
+
+typedef struct producer {
+  pthread_t tid;
+  stressctx* sctx;
+  int shard;                // we touch tablets congruent to shard
+  unsigned seed;
+} producer;
+
+static inline uint64_t
+monotonic_ns(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * NANOSECS_IN_SEC + ts.tv_nsec;
+}
+
+static int
+append_u64(uint64_t** arr, unsigned long* count, unsigned long* alloc,
+           uint64_t val){
+  if(*count == *alloc){
+    unsigned long newalloc = *alloc ? *alloc * 2 : 1024;
+    uint64_t* tmp = realloc(*arr, sizeof(**arr) * newalloc);
+    if(tmp == NULL){
+      return -1;
+    }
+    *arr = tmp;
+    *alloc = newalloc;
+  }
+  (*arr)[(*count)++] = val;
+  return 0;
+}
+
+static int
+stressdraw(struct tablet* t, int begx, int begy, int maxx, int maxy,
+           bool cliptop){
+  stresstablet* st = tablet_userptr(t);
+  stressctx* sctx = st->sctx;
+  WINDOW* w = panel_window(tablet_panel(t));
+  int lines = atomic_load(&st->lines);
+  int y;
+  (void)maxx;
+  (void)cliptop;
+  for(y = begy ; y <= maxy && y - begy < lines ; ++y){
+    wmove(w, y, begx);
+    wclrtoeol(w);
+    mvwprintw(w, y, begx, "[#%u %d/%d]", st->id, y - begy + 1, lines);
+  }
+  uint64_t touched = atomic_exchange(&st->touchns, 0);
+  if(touched){
+    append_u64(&sctx->drawn, &sctx->drawncount, &sctx->drawnalloc, touched);
+  }
+  return y - begy;
+}
+
+// A frame might have just been written. The tablets drawn for it were
+// touched at the times in drawn.
+static void
+settle(stressctx* sctx){
+  uint64_t now = monotonic_ns();
+  unsigned long i;
+  for(i = 0 ; i < sctx->drawncount ; ++i){
+    append_u64(&sctx->samples, &sctx->samplecount, &sctx->samplealloc,
+               now - sctx->drawn[i]);
+  }
+  sctx->drawncount = 0;
+}
+
+static void*
+producer_thread(void* vproducer){
+  producer* p = vproducer;
+  stressctx* sctx = p->sctx;
+  int pershard = (sctx->count - p->shard + STRESS_PRODUCERS - 1) / STRESS_PRODUCERS;
+  uint64_t deadline = monotonic_ns();
+  while(!atomic_load(&sctx->stop)){
+    deadline += sctx->intervalns;
+    struct timespec ts = {
+      .tv_sec = deadline / NANOSECS_IN_SEC,
+      .tv_nsec = deadline % NANOSECS_IN_SEC,
+    };
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    stresstablet* st = &sctx->tablets[p->shard + (rand_r(&p->seed) % pershard) * STRESS_PRODUCERS];
+    if(rand_r(&p->seed) % 8 == 0){ // sometimes change size
+      atomic_store(&st->lines, rand_r(&p->seed) % STRESS_MAXLINES + 1);
+    }
+    unsigned long long untouched = 0;
+    atomic_compare_exchange_strong(&st->touchns, &untouched, monotonic_ns());
+    panelreel_touch(sctx->pr, st->t);
+  }
+  return NULL;
+}
+
+// Touched tablets which are offscreen won't be drawn, so forget when they
+// were touched, lest they be charged for the time until they're scrolled to.
+static int
+update_reel(stressctx* sctx){
+  struct tablet* touched[256];
+  int n;
+  do{
+    n = panelreel_drain_touched(sctx->pr, touched, sizeof(touched) / sizeof(*touched));
+    int i;
+    for(i = 0 ; i < n ; ++i){
+      if(tablet_panel(touched[i]) == NULL){
+        stresstablet* st = tablet_userptr(touched[i]);
+        atomic_store(&st->touchns, 0);
+      }
+    }
+  }while(n == sizeof(touched) / sizeof(*touched));
+  return panelreel_update(sctx->pr);
+}
+
+static void
+navigate(stressctx* sctx, char step, unsigned* seed){
+  struct panelreel* pr = sctx->pr;
+  switch(step){
+    case 'j': panelreel_next(pr); break;
+    case 'k': panelreel_prev(pr); break;
+    case 'N': panelreel_page_down(pr); break;
+    case 'P': panelreel_page_up(pr); break;
+    case 'H': panelreel_focus_index(pr, 0); break;
+    case 'E': panelreel_focus_index(pr, sctx->count - 1); break;
+    case 'r': panelreel_focus_index(pr, rand_r(seed) % sctx->count); break;
+  }
+}
+
+static int
+cmp_u64(const void* va, const void* vb){
+  uint64_t a = *(const uint64_t*)va;
+  uint64_t b = *(const uint64_t*)vb;
+  return a < b ? -1 : a > b;
+}
+
+static double
+percentile_ms(const uint64_t* sorted, unsigned long count, unsigned pct){
+  if(count == 0){
+    return 0;
+  }
+  return sorted[(count - 1) * pct / 100] / (double)NANOSECS_IN_MS;
+}
+
+// Run the reel until seconds have elapsed, or q is pressed.
+static int
+stress_loop(WINDOW* w, stressctx* sctx, struct panelreel_sched* sched,
+            int efd, unsigned seconds){
+  struct pollfd fds[3] = {
+    { .fd = STDIN_FILENO, .events = POLLIN, .revents = 0, },
+    { .fd = efd,          .events = POLLIN, .revents = 0, },
+    { .fd = panelreel_sched_fd(sched), .events = POLLIN, .revents = 0, },
+  };
+  unsigned navseed = 1;
+  size_t navstep = 0;
+  uint64_t start = monotonic_ns();
+  uint64_t end = start + seconds * NANOSECS_IN_SEC;
+  uint64_t nextnav = start + STRESS_NAV_MS * NANOSECS_IN_MS;
+  uint64_t now;
+  while((now = monotonic_ns()) < end){
+    if(now >= nextnav){
+      navigate(sctx, NAVSCRIPT[navstep++ % (sizeof(NAVSCRIPT) - 1)], &navseed);
+      nextnav += STRESS_NAV_MS * NANOSECS_IN_MS;
+      continue;
+    }
+    int pret = poll(fds, sizeof(fds) / sizeof(*fds),
+                    (nextnav - now + NANOSECS_IN_MS - 1) / NANOSECS_IN_MS);
+    if(pret < 0){
+      if(errno == EINTR){
+        continue;
+      }
+      fprintf(stderr, "Error polling on stdin/eventfd/timerfd (%s)\n", strerror(errno));
+      return -1;
+    }
+    if(fds[0].revents & POLLIN){
+      if(wgetch(w) == 'q'){
+        break;
+      }
+    }
+    if(fds[1].revents & POLLIN){
+      uint64_t val;
+      if(read(efd, &val, sizeof(val)) != sizeof(val)){
+        fprintf(stderr, "Error reading from eventfd %d (%s)\n", efd, strerror(errno));
+      }
+      update_reel(sctx);
+    }
+    if(fds[2].revents & POLLIN){
+      panelreel_sched_run(sched);
+      settle(sctx);
+    }
+  }
+  return 0;
+}
+
+int panelreel_stress(WINDOW* w, int tablets, unsigned rate, unsigned seconds,
+                     stress_report* report){
+  memset(report, 0, sizeof(*report));
+  if(tablets <= 0 || rate == 0 || seconds == 0){
+    fprintf(stderr, "Invalid stress parameters\n");
+    return -1;
+  }
+  // with fewer tablets than producers, spread the rate over those we need
+  int nproducers = tablets < STRESS_PRODUCERS ? tablets : STRESS_PRODUCERS;
+  stressctx sctx = {
+    .count = tablets,
+    .intervalns = nproducers * NANOSECS_IN_SEC / rate,
+  };
+  atomic_init(&sctx.stop, false);
+  int efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if(efd < 0){
+    fprintf(stderr, "Error creating eventfd (%s)\n", strerror(errno));
+    return -1;
+  }
+  panelreel_options popts = {
+    .infinitescroll = true,
+    .circular = true,
+    .min_supported_cols = 8,
+    .min_supported_rows = 5,
+    .borderpair = COLOR_MAGENTA,
+    .tabletpair = COLOR_GREEN,
+    .focusedpair = COLOR_RED,
+    .toff = 2,
+  };
+  int ret = -1;
+  struct panelreel_sched* sched = NULL;
+  void** opaques = NULL;
+  producer producers[STRESS_PRODUCERS];
+  int started = 0;
+  if((sctx.pr = panelreel_create(w, &popts, efd)) == NULL){
+    fprintf(stderr, "Error creating panelreel\n");
+    goto done;
+  }
+  if((sched = panelreel_sched_create(sctx.pr, DEMO_MAXFPS)) == NULL){
+    fprintf(stderr, "Error creating panelreel scheduler\n");
+    goto done;
+  }
+  sctx.tablets = malloc(sizeof(*sctx.tablets) * tablets);
+  opaques = malloc(sizeof(*opaques) * tablets);
+  struct tablet** handles = malloc(sizeof(*handles) * tablets);
+  if(sctx.tablets == NULL || opaques == NULL || handles == NULL){
+    free(handles);
+    goto done;
+  }
+  int i;
+  for(i = 0 ; i < tablets ; ++i){
+    stresstablet* st = &sctx.tablets[i];
+    st->sctx = &sctx;
+    atomic_init(&st->lines, i % STRESS_MAXLINES + 1);
+    atomic_init(&st->touchns, 0);
+    st->id = i;
+    opaques[i] = st;
+  }
+  if(panelreel_add_many(sctx.pr, NULL, NULL, stressdraw, opaques, tablets,
+                        handles) != tablets){
+    fprintf(stderr, "Error adding %d tablets\n", tablets);
+    free(handles);
+    goto done;
+  }
+  for(i = 0 ; i < tablets ; ++i){
+    sctx.tablets[i].t = handles[i];
+  }
+  free(handles);
+  settle(&sctx); // tablets drawn while being added weren't touched
+  sctx.samplecount = 0;
+  int pair = COLOR_CYAN;
+  wattr_set(w, A_NORMAL, 0, &pair);
+  mvwprintw(w, 0, 1, "Stressing %d tablets at %u touches/s for %us; q quits.",
+            tablets, rate, seconds);
+  wrefresh(w);
+  panelreel_reset_stats(sctx.pr);
+  for(started = 0 ; started < nproducers ; ++started){
+    producer* p = &producers[started];
+    p->sctx = &sctx;
+    p->shard = started;
+    p->seed = started + 1;
+    if(pthread_create(&p->tid, NULL, producer_thread, p)){
+      fprintf(stderr, "Error launching producer (%s)\n", strerror(errno));
+      goto done;
+    }
+  }
+  uint64_t start = monotonic_ns();
+  ret = stress_loop(w, &sctx, sched, efd, seconds);
+  report->seconds = (monotonic_ns() - start) / (double)NANOSECS_IN_SEC;
+
+done:
+  atomic_store(&sctx.stop, true);
+  while(started){
+    pthread_join(producers[--started].tid, NULL);
+  }
+  if(sctx.pr){
+    panelreel_stats stats;
+    panelreel_get_stats(sctx.pr, &stats);
+    report->tablets = sctx.count;
+    report->touches = stats.touches;
+    report->frames = stats.frames;
+    report->callbacks = stats.callbacks;
+    qsort(sctx.samples, sctx.samplecount, sizeof(*sctx.samples), cmp_u64);
+    report->samples = sctx.samplecount;
+    report->p50_ms = percentile_ms(sctx.samples, sctx.samplecount, 50);
+    report->p99_ms = percentile_ms(sctx.samples, sctx.samplecount, 99);
+  }
+  panelreel_sched_destroy(sched);
+  if(sctx.pr && panelreel_destroy(sctx.pr)){
+    fprintf(stderr, "Error destroying panelreel\n");
+    ret = -1;
+  }
+  free(sctx.samples);
+  free(sctx.drawn);
+  free(opaques);
+  free(sctx.tablets);
+  close(efd);
+  return ret;
+}
@@ -1,3 +1,4 @@
+#include <stdlib.h>
 #include "outcurses.h"
 #include "colors.h"
 
@@ -8,36 +9,283 @@
 // default color for its context (foreground or background) as inherited from
 // the terminal, via the magic of assume_default_colors().
 //
-// We set up the color pairs so that each block of 256 pairs is the 256 colors
-// as the foreground, with one of the 256 as the background.
+// We only set up the first (up to) 256 pairs eagerly, each being its palette
+// equivalent as the foreground atop the default background. Initializing all
+// COLOR_PAIRS up front cost us ~65k init_extended_pair() calls on 256-color
+// terminals. Every other combination is set up lazily by outcurses_pair(),
+// which hashes (fg, bg) to a pair and refcounts it. Once COLOR_PAIRS has been
+// exhausted, the least recently released unreferenced pair is recycled.
+#define FIXED_PAIRS_MAX 256
+
+typedef struct colorpair {
+  int fg, bg;
+  unsigned refs;
+  bool hashed;     // is this entry reachable via the hash?
+  int hnext;       // next entry in hash chain, -1 to terminate
+  int lruprev;     // unreferenced entries, least recently released first
+  int lrunext;
+} colorpair;
+
+static struct {
+  colorpair* pairs;      // dynamic pairs, indexed by pair number - fixed
+  int pairsalloc;        // entries allocated in pairs
+  int pairsused;         // entries handed out at least once
+  int fixed;             // pairs [1, fixed) are (pair, -1); 0 if unprepared
+  int* buckets;          // heads of hash chains, -1 if empty
+  unsigned bucketcount;  // always a power of 2
+  int lruhead, lrutail;  // -1 if no unreferenced pairs
+} cpa = {
+  .lruhead = -1,
+  .lrutail = -1,
+};
+
+static inline unsigned
+pair_hash(int fg, int bg){
+  return ((unsigned)fg * 0x9e3779b1u) ^ ((unsigned)bg * 0x85ebca77u);
+}
+
+static void
+lru_unlink(int idx){
+  colorpair* cp = &cpa.pairs[idx];
+  if(cp->lruprev >= 0){
+    cpa.pairs[cp->lruprev].lrunext = cp->lrunext;
+  }else{
+    cpa.lruhead = cp->lrunext;
+  }
+  if(cp->lrunext >= 0){
+    cpa.pairs[cp->lrunext].lruprev = cp->lruprev;
+  }else{
+    cpa.lrutail = cp->lruprev;
+  }
+  cp->lruprev = cp->lrunext = -1;
+}
+
+static void
+lru_append(int idx){
+  colorpair* cp = &cpa.pairs[idx];
+  cp->lrunext = -1;
+  if((cp->lruprev = cpa.lrutail) >= 0){
+    cpa.pairs[cpa.lrutail].lrunext = idx;
+  }else{
+    cpa.lruhead = idx;
+  }
+  cpa.lrutail = idx;
+}
+
+static void
+hash_insert(int idx){
+  colorpair* cp = &cpa.pairs[idx];
+  unsigned b = pair_hash(cp->fg, cp->bg) & (cpa.bucketcount - 1);
+  cp->hnext = cpa.buckets[b];
+  cpa.buckets[b] = idx;
+  cp->hashed = true;
+}
+
+static void
+hash_remove(int idx){
+  colorpair* cp = &cpa.pairs[idx];
+  int* prev = &cpa.buckets[pair_hash(cp->fg, cp->bg) & (cpa.bucketcount - 1)];
+  while(*prev != idx){
+    prev = &cpa.pairs[*prev].hnext;
+  }
+  *prev = cp->hnext;
+  cp->hashed = false;
+}
+
+static int
+hash_lookup(int fg, int bg){
+  if(cpa.bucketcount == 0){
+    return -1;
+  }
+  int idx = cpa.buckets[pair_hash(fg, bg) & (cpa.bucketcount - 1)];
+  while(idx >= 0){
+    if(cpa.pairs[idx].fg == fg && cpa.pairs[idx].bg == bg){
+      break;
+    }
+    idx = cpa.pairs[idx].hnext;
+  }
+  return idx;
+}
+
+// Keep the load factor at or below 1. Chains are rebuilt from scratch.
+static int
+hash_grow(void){
+  unsigned newcount = cpa.bucketcount ? cpa.bucketcount * 2 : 256;
+  int* newbuckets = malloc(sizeof(*newbuckets) * newcount);
+  if(newbuckets == NULL){
+    return -1;
+  }
+  free(cpa.buckets);
+  cpa.buckets = newbuckets;
+  cpa.bucketcount = newcount;
+  unsigned b;
+  for(b = 0 ; b < newcount ; ++b){
+    cpa.buckets[b] = -1;
+  }
+  int idx;
+  for(idx = 0 ; idx < cpa.pairsused ; ++idx){
+    if(cpa.pairs[idx].hashed){
+      hash_insert(idx);
+    }
+  }
+  return 0;
+}
+
+// Get a never-before-used entry, if COLOR_PAIRS allows it, or else recycle
+// the least recently released one. Returns -1 if every pair is referenced.
+static int
+claim_entry(void){
+  if(cpa.fixed + cpa.pairsused < COLOR_PAIRS){
+    if(cpa.pairsused == cpa.pairsalloc){
+      int newalloc = cpa.pairsalloc ? cpa.pairsalloc * 2 : 256;
+      colorpair* tmp = realloc(cpa.pairs, sizeof(*tmp) * newalloc);
+      if(tmp == NULL){
+        return -1;
+      }
+      cpa.pairs = tmp;
+      cpa.pairsalloc = newalloc;
+    }
+    if((unsigned)cpa.pairsused >= cpa.bucketcount){
+      if(hash_grow()){
+        return -1;
+      }
+    }
+    int idx = cpa.pairsused++;
+    cpa.pairs[idx].hashed = false;
+    cpa.pairs[idx].lruprev = cpa.pairs[idx].lrunext = -1;
+    return idx;
+  }
+  int idx = cpa.lruhead;
+  if(idx >= 0){
+    lru_unlink(idx);
+    if(cpa.pairs[idx].hashed){
+      hash_remove(idx);
+    }
+  }
+  return idx;
+}
+
+static void
+free_pairs(void){
+  free(cpa.pairs);
+  free(cpa.buckets);
+  cpa.pairs = NULL;
+  cpa.buckets = NULL;
+  cpa.pairsalloc = 0;
+  cpa.pairsused = 0;
+  cpa.bucketcount = 0;
+  cpa.lruhead = cpa.lrutail = -1;
+}
+
+static int
+init_fixed_pairs(void){
+  int pair;
+  for(pair = 1 ; pair < cpa.fixed ; ++pair){
+    if(init_extended_pair(pair, pair, -1)){
+      fprintf(stderr, "Warning: couldn't initialize colorpair %d/%d\n", pair, COLOR_PAIRS);
+      return -1;
+    }
+  }
+  return 0;
+}
+
 int prep_colors(void){
   if(start_color() != OK){
     fprintf(stderr, "Couldn't start color support\n");
     return -1;
   }
+  clear_palette();
   // Use the default terminal colors for COLOR(-1), then defines COLOR_PAIR(0)
   // to be -1, -1 (default terminal colors). assume_default_colors(-1, -1)
   // encompasses use_default_colors().
   if(assume_default_colors(-1, -1) != OK){
     fprintf(stderr, "Warning: couldn't assume default colors\n");
   }
-  int bg;
-  int pair = 0;
-  for(bg = -1 ; bg < COLORS - 1 ; ++bg){
-    int i;
-    for(i = 0 ; i < COLORS ; ++i){
-      if(pair >= COLOR_PAIRS){
-        break;
-      }
-      if(pair){
-        if(init_extended_pair(pair, i, bg)){
-          fprintf(stderr, "Warning: couldn't initialize colorpair %d/%d\n", pair, COLOR_PAIRS);
-          goto err;
-        }
+  free_pairs();
+  cpa.fixed = COLORS < FIXED_PAIRS_MAX ? COLORS : FIXED_PAIRS_MAX;
+  if(cpa.fixed > COLOR_PAIRS){
+    cpa.fixed = COLOR_PAIRS;
+  }
+  if(cpa.fixed < 1){
+    cpa.fixed = 1;
+  }
+  init_fixed_pairs();
+  return 0;
+}
+
+int reprep_pairs(void){
+  int ret = 0;
+  if(init_fixed_pairs()){
+    ret = -1;
+  }
+  int idx;
+  for(idx = 0 ; idx < cpa.pairsused ; ++idx){
+    const colorpair* cp = &cpa.pairs[idx];
+    if(cp->hashed){
+      if(init_extended_pair(cpa.fixed + idx, cp->fg, cp->bg)){
+        ret = -1;
       }
-      ++pair;
     }
   }
-err:
+  return ret;
+}
+
+void stop_colors(void){
+  free_pairs();
+  clear_palette();
+  cpa.fixed = 0;
+}
+
+int outcurses_pair(int fg, int bg){
+  if(fg < -1 || bg < -1 || fg >= COLORS || bg >= COLORS){
+    return -1;
+  }
+  if(fg == -1 && bg == -1){
+    return 0;
+  }
+  // if ncurses was initialized by the application, we never ran prep_colors(),
+  // and have no fixed pairs. pair 0 is never available, though.
+  if(cpa.fixed == 0){
+    cpa.fixed = 1;
+  }
+  if(bg == -1 && fg > 0 && fg < cpa.fixed){
+    return fg;
+  }
+  int idx = hash_lookup(fg, bg);
+  if(idx >= 0){
+    if(cpa.pairs[idx].refs++ == 0){
+      lru_unlink(idx);
+    }
+    return cpa.fixed + idx;
+  }
+  if((idx = claim_entry()) < 0){
+    return -1;
+  }
+  colorpair* cp = &cpa.pairs[idx];
+  if(init_extended_pair(cpa.fixed + idx, fg, bg)){
+    lru_append(idx); // unhashed, so nothing will find it until recycled
+    return -1;
+  }
+  cp->fg = fg;
+  cp->bg = bg;
+  cp->refs = 1;
+  hash_insert(idx);
+  return cpa.fixed + idx;
+}
+
+int outcurses_pair_release(int pair){
+  if(pair < 0){
+    return -1;
+  }
+  if(pair < cpa.fixed || pair == 0){
+    return 0; // fixed pairs are never released
+  }
+  int idx = pair - cpa.fixed;
+  if(idx >= cpa.pairsused || !cpa.pairs[idx].hashed || cpa.pairs[idx].refs == 0){
+    return -1;
+  }
+  if(--cpa.pairs[idx].refs == 0){
+    lru_append(idx);
+  }
   return 0;
 }
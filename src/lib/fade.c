@@ -1,8 +1,17 @@
 #include <time.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <sys/time.h>
+#include <sys/ioctl.h>
+#include <sys/timerfd.h>
 #include "outcurses.h"
+#include "headless.h"
+#include "colors.h"
+#include "trace.h"
 
 // These arrays are too large to be safely placed on the stack.
 static int
@@ -19,193 +28,811 @@ alloc_palette(int count, outcurses_rgb** orig, outcurses_rgb** cur){
   return 0;
 }
 
-int retrieve_palette(int count, outcurses_rgb* palette, outcurses_rgb* maxes,
-                     bool zeroout){
-  outcurses_rgb maxes_store;
-  int p;
+#define NANOSECS_IN_SEC 1000000000ull
+#define NANOSECS_IN_MS  (NANOSECS_IN_SEC / 1000ul)
+
+// Components are interpolated in 16.16 fixed point. Components never exceed
+// 1000, so neither the values nor the products below approach overflow.
+#define FADE_FRACBITS 16
+
+// The colors which differ between the endpoints of a fade, in struct-of-arrays
+// form so that stepping them is a few simple loops the compiler can vectorize.
+// Colors which don't differ are never touched.
+typedef struct fadeplan {
+  int count;       // number of changing colors
+  int maxsteps;    // largest component delta; no point in more steps
+  int32_t* idx;      // palette index of each changing color
+  int32_t* base[3];  // starting components, in fixed point
+  int32_t* delta[3]; // per-step change, in fixed point
+  int32_t* cur[3];   // components for the current step
+  int32_t* last[3];  // components last written, -1 if never written
+} fadeplan;
 
-  if(maxes == NULL){
-    maxes = &maxes_store;
+static void
+free_fadeplan(fadeplan* fp){
+  free(fp->idx); // all the arrays share this allocation
+}
+
+static int
+prep_fadeplan(fadeplan* fp, int count, const outcurses_rgb* from,
+              const outcurses_rgb* to){
+  int p, c;
+  fp->count = 0;
+  fp->maxsteps = 0;
+  fp->idx = NULL;
+  for(p = 0 ; p < count ; ++p){
+    int dr = abs(to[p].r - from[p].r);
+    int dg = abs(to[p].g - from[p].g);
+    int db = abs(to[p].b - from[p].b);
+    int d = dr > dg ? (dr > db ? dr : db) : (dg > db ? dg : db);
+    if(d){
+      ++fp->count;
+      if(d > fp->maxsteps){
+        fp->maxsteps = d;
+      }
+    }
+  }
+  if(fp->count == 0){
+    return 0;
+  }
+  // one allocation: idx, then 3 each of base, delta, cur, and last
+  size_t n = fp->count;
+  if((fp->idx = malloc(n * sizeof(*fp->idx) * (1 + 12))) == NULL){
+    return -1;
+  }
+  for(c = 0 ; c < 3 ; ++c){
+    fp->base[c] = fp->idx + n * (1 + c);
+    fp->delta[c] = fp->idx + n * (4 + c);
+    fp->cur[c] = fp->idx + n * (7 + c);
+    fp->last[c] = fp->idx + n * (10 + c);
   }
-  maxes->r = maxes->g = maxes->b = -1;
+  int i = 0;
   for(p = 0 ; p < count ; ++p){
-    if(extended_color_content(p, &palette[p].r, &palette[p].g, &palette[p].b) != OK){
-      return -1;
+    const int f[3] = { from[p].r, from[p].g, from[p].b, };
+    const int t[3] = { to[p].r, to[p].g, to[p].b, };
+    if(f[0] == t[0] && f[1] == t[1] && f[2] == t[2]){
+      continue;
+    }
+    fp->idx[i] = p;
+    for(c = 0 ; c < 3 ; ++c){
+      fp->base[c][i] = f[c] * (1 << FADE_FRACBITS);
+      // truncation toward zero keeps every step between the endpoints
+      fp->delta[c][i] = (t[c] - f[c]) * (1 << FADE_FRACBITS) / fp->maxsteps;
+      fp->last[c][i] = -1;
+    }
+    ++i;
+  }
+  return 0;
+}
+
+// Compute the components for step iter of maxsteps. Step 0 is the origin, and
+// the final step lands exactly on the destination.
+static void
+step_fadeplan(fadeplan* fp, const outcurses_rgb* to, int iter){
+  int c, i;
+  if(iter >= fp->maxsteps){
+    for(i = 0 ; i < fp->count ; ++i){
+      fp->cur[0][i] = to[fp->idx[i]].r;
+      fp->cur[1][i] = to[fp->idx[i]].g;
+      fp->cur[2][i] = to[fp->idx[i]].b;
     }
-    if(palette[p].r > maxes->r){
-      maxes->r = palette[p].r;
+    return;
+  }
+  for(c = 0 ; c < 3 ; ++c){
+    const int32_t* restrict base = fp->base[c];
+    const int32_t* restrict delta = fp->delta[c];
+    int32_t* restrict cur = fp->cur[c];
+    for(i = 0 ; i < fp->count ; ++i){
+      cur[i] = (base[i] + delta[i] * iter) >> FADE_FRACBITS;
+    }
+  }
+}
+
+// Write those colors which changed since they were last written. Returns the
+// number written, or -1 on failure.
+static int
+apply_fadeplan(fadeplan* fp){
+  int written = 0;
+  int i;
+  for(i = 0 ; i < fp->count ; ++i){
+    int r = fp->cur[0][i], g = fp->cur[1][i], b = fp->cur[2][i];
+    if(r == fp->last[0][i] && g == fp->last[1][i] && b == fp->last[2][i]){
+      continue;
     }
-    if(palette[p].g > maxes->g){
-      maxes->g = palette[p].g;
+    const outcurses_rgb rgb = { .r = r, .g = g, .b = b, };
+    if(palette_set(fp->idx[i], &rgb)){
+      return -1;
     }
-    if(palette[p].b > maxes->b){
-      maxes->b = palette[p].b;
+    fp->last[0][i] = r;
+    fp->last[1][i] = g;
+    fp->last[2][i] = b;
+    ++written;
+  }
+  return written;
+}
+
+// A fade in progress, whether driven by fadeto() or the caller's event loop.
+typedef struct fade {
+  WINDOW* w;
+  int count;
+  outcurses_rgb* orig;     // palette upon starting, restored by fade_cancel()
+  outcurses_rgb* to;       // destination palette
+  fadeplan fp;
+  uint64_t startns;        // CLOCK_MONOTONIC ns at the start
+  uint64_t nanosecs_step;  // ideal time between steps
+  int iter;                // last step written, -1 if none
+  int fd;                  // timerfd, or -1 for blocking fades
+  int ofd;                 // terminal output, -1 if its queue can't be read
+  int framebytes;          // moving average of bytes queued per step
+  uint64_t costns;         // ns per color written, once writes have blocked
+  uint64_t lastwrite;      // CLOCK_MONOTONIC ns when the last write finished
+  int lastcolors;          // colors written by the last step
+  int visited;             // last step written or dropped, -1 if none
+  uint64_t totalns;        // requested duration
+  outcurses_fade_stats stats;
+} fade;
+
+// The most recent blocking fade's statistics.
+static outcurses_fade_stats last_stats;
+static bool last_stats_valid;
+
+// Steps are dropped while more than this much output (or a step's worth, if
+// that's more) remains queued for the terminal. Anything more than a step
+// behind is stale by the time it's displayed.
+#define FADE_BACKLOG_MIN 512
+
+// A step whose writes take longer than this is taken to have blocked on a
+// saturated link. Unblocked, even the largest step takes a fraction of this.
+#define FADE_BLOCKED_NS (NANOSECS_IN_MS * 2)
+
+// Output queued for the terminal but not yet consumed, or -1 if unknown.
+static int
+output_backlog(fade* f){
+  int queued;
+  if(f->ofd < 0){
+    return -1;
+  }
+  if(ioctl(f->ofd, TIOCOUTQ, &queued)){
+    f->ofd = -1; // not a tty; don't try again
+    return -1;
+  }
+  return queued;
+}
+
+static inline uint64_t
+monotonic_ns(void){
+  struct timespec times;
+  clock_gettime(CLOCK_MONOTONIC, &times);
+  return times.tv_sec * NANOSECS_IN_SEC + times.tv_nsec;
+}
+
+static void
+release_fade(fade* f){
+  free_fadeplan(&f->fp);
+  free(f->orig); // to shares this allocation
+}
+
+static int
+prep_fade(fade* f, WINDOW* w, int count, const outcurses_rgb* from,
+          const outcurses_rgb* to, unsigned ms){
+  f->w = w;
+  f->count = count;
+  f->iter = -1;
+  f->fd = -1;
+  f->ofd = headless_active() ? headless_fd() : STDOUT_FILENO;
+  f->framebytes = 0;
+  f->costns = 0;
+  f->lastwrite = 0;
+  f->lastcolors = 0;
+  f->visited = -1;
+  memset(&f->stats, 0, sizeof(f->stats));
+  f->fp.idx = NULL;
+  if((f->orig = malloc(sizeof(*f->orig) * count * 2)) == NULL){
+    return -1;
+  }
+  f->to = f->orig + count;
+  memcpy(f->to, to, sizeof(*to) * count);
+  if(retrieve_palette(count, f->orig, NULL, false)){
+    release_fade(f);
+    return -1;
+  }
+  if(prep_fadeplan(&f->fp, count, from ? from : f->orig, f->to)){
+    release_fade(f);
+    return -1;
+  }
+  // We have this many nanoseconds to work through maxsteps iterations, the
+  // last of which is reached at the deadline. Our natural rate might be slower
+  // or faster than what's desirable, so at each iteration, we (a) set the
+  // palette to the intensity corresponding to time since the fade started, and
+  // (b) sleep if we're early (otherwise we peg a core unnecessarily).
+  f->totalns = ms * NANOSECS_IN_MS;
+  f->nanosecs_step = f->fp.maxsteps ? f->totalns / f->fp.maxsteps : 0;
+  f->stats.steps = f->fp.maxsteps;
+  f->startns = monotonic_ns();
+  return 0;
+}
+
+// Write the step appropriate to the current time, unless the terminal hasn't
+// yet consumed the previous ones, in which case the step is dropped (the
+// final step is never dropped). Since steps are chosen by time, dropping them
+// keeps the fade on schedule at whatever rate the terminal can sustain.
+//
+// Where the kernel reports the output queue (TIOCOUTQ), we drop steps while
+// more than a step's worth is queued. Ptys always report an empty queue, so
+// we also watch how long writes take: they only block once the link is
+// saturated, whereupon their duration tells us what each color costs. From
+// then on, steps are paced to use at most half the link, so the backlog
+// drains rather than persisting.
+//
+// Returns 1 if the fade is complete, or 0 and the absolute time of the next
+// step in *deadline.
+static int
+advance_fade(fade* f, uint64_t* deadline){
+  outcurses_fade_stats* stats = &f->stats;
+  if(f->fp.count == 0){ // nothing to do
+    return 1;
+  }
+  uint64_t elapsed = monotonic_ns() - f->startns;
+  int iter = f->fp.maxsteps;
+  if(f->nanosecs_step && elapsed / f->nanosecs_step < (uint64_t)iter){
+    iter = elapsed / f->nanosecs_step;
+  } // otherwise, we're late (or have no time at all); finish up
+  if(iter != f->visited){ // woken early, perhaps
+    if(iter > f->visited + 1){
+      ++stats->late_wakeups;
+      stats->missed += iter - f->visited - 1;
     }
-    if(zeroout){
-      if(init_extended_color(p, 0, 0, 0) != OK){
+    f->visited = iter;
+    uint64_t now = f->startns + elapsed;
+    int before = output_backlog(f);
+    int limit = f->framebytes > FADE_BACKLOG_MIN ? f->framebytes : FADE_BACKLOG_MIN;
+    uint64_t idle = 2 * f->costns * f->lastcolors;
+    if(iter == f->fp.maxsteps ||
+       (before <= limit && now - f->lastwrite >= idle)){
+      TRACE_BEGIN("fade_step");
+      step_fadeplan(&f->fp, f->to, iter);
+      int colors = apply_fadeplan(&f->fp);
+      if(colors < 0){
+        TRACE_END("fade_step");
         return -1;
       }
+      uint64_t written = monotonic_ns();
+      wrefresh(f->w);
+      TRACE_END("fade_step");
+      f->iter = iter;
+      int after = output_backlog(f);
+      if(before >= 0 && after >= before){
+        f->framebytes += (after - before - f->framebytes) / 4;
+      }
+      f->lastwrite = monotonic_ns();
+      stats->palette_ns += written - now;
+      stats->refresh_ns += f->lastwrite - written;
+      stats->colors += colors;
+      ++stats->frames;
+      // latency is measured from when the step became due
+      uint64_t due = f->startns + iter * f->nanosecs_step;
+      uint64_t latus = (f->lastwrite - (due < f->lastwrite ? due : f->lastwrite)) / 1000;
+      int bucket = 0;
+      while(latus >= 2 && bucket < OUTCURSES_FADE_LATENCY_BUCKETS - 1){
+        latus /= 2;
+        ++bucket;
+      }
+      ++stats->latency[bucket];
+      uint64_t took = f->lastwrite - now;
+      if(took > FADE_BLOCKED_NS && colors){
+        uint64_t cost = took / colors;
+        f->costns = f->costns ? (f->costns * 3 + cost) / 4 : cost;
+      }
+      f->lastcolors = colors;
+    }else{
+      ++stats->dropped;
     }
   }
+  if(iter == f->fp.maxsteps){
+    stats->overrun_ns = (long)(f->lastwrite - (f->startns + f->totalns));
+    return 1;
+  }
+  *deadline = (iter + 1) * f->nanosecs_step + f->startns;
   return 0;
 }
 
-int set_palette(int count, const outcurses_rgb* palette){
-  int p;
+int fadeto(WINDOW* w, int count, const outcurses_rgb* from,
+           const outcurses_rgb* to, unsigned ms){
+  uint64_t nextwake;
+  fade f;
+  int r;
 
-  for(p = 0 ; p < count ; ++p){
-    if(init_extended_color(p, palette[p].r, palette[p].g, palette[p].b) != OK){
-      return -1;
+  if(prep_fade(&f, w, count, from, to, ms)){
+    return -1;
+  }
+  TRACE_BEGIN("fadeto");
+  while((r = advance_fade(&f, &nextwake)) == 0){
+    struct timespec sleepspec;
+    sleepspec.tv_sec = nextwake / NANOSECS_IN_SEC;
+    sleepspec.tv_nsec = nextwake % NANOSECS_IN_SEC;
+    // clock_nanosleep() has no love for CLOCK_MONOTONIC_RAW, at least as
+    // of Glibc 2.29 + Linux 5.3 :/.
+    if(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &sleepspec, NULL)){
+      r = -1;
+      break;
     }
   }
+  TRACE_END("fadeto");
+  last_stats = f.stats;
+  last_stats_valid = true;
+  release_fade(&f);
+  return r < 0 ? -1 : 0;
+}
+
+int outcurses_last_fade_stats(outcurses_fade_stats* stats){
+  if(!last_stats_valid){
+    return -1;
+  }
+  *stats = last_stats;
   return 0;
 }
 
-#define NANOSECS_IN_SEC 1000000000ull
-#define NANOSECS_IN_MS  (NANOSECS_IN_SEC / 1000ul)
+void fade_get_stats(const fade* f, outcurses_fade_stats* stats){
+  *stats = f->stats;
+}
+
+// Arm the timerfd for an absolute CLOCK_MONOTONIC deadline.
+static int
+arm_fade(fade* f, uint64_t deadline){
+  struct itimerspec its = {
+    .it_interval = { .tv_sec = 0, .tv_nsec = 0, },
+    .it_value = {
+      .tv_sec = deadline / NANOSECS_IN_SEC,
+      .tv_nsec = deadline % NANOSECS_IN_SEC,
+    },
+  };
+  return timerfd_settime(f->fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+fade* fade_start(WINDOW* w, int count, const outcurses_rgb* from,
+                 const outcurses_rgb* to, unsigned ms){
+  fade* f = malloc(sizeof(*f));
+  if(f == NULL){
+    return NULL;
+  }
+  if(prep_fade(f, w, count, from, to, ms)){
+    free(f);
+    return NULL;
+  }
+  if((f->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0){
+    fprintf(stderr, "Error creating timerfd (%s)\n", strerror(errno));
+    release_fade(f);
+    free(f);
+    return NULL;
+  }
+  // write the first step immediately. if that completes the fade, the timer
+  // fires right away, and fade_step() reports completion.
+  uint64_t deadline;
+  int r = advance_fade(f, &deadline);
+  if(r < 0 || arm_fade(f, r ? f->startns : deadline)){
+    fade_destroy(f);
+    return NULL;
+  }
+  return f;
+}
+
+int fade_fd(const fade* f){
+  return f->fd;
+}
+
+int fade_step(fade* f){
+  uint64_t expirations;
+  if(read(f->fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN){
+    fprintf(stderr, "Error reading timerfd %d (%s)\n", f->fd, strerror(errno));
+    return -1;
+  }
+  uint64_t deadline;
+  int r = advance_fade(f, &deadline);
+  if(r == 0 && arm_fade(f, deadline)){
+    return -1;
+  }
+  return r;
+}
+
+int fade_cancel(fade* f){
+  int ret = 0;
+  if(f){
+    ret = set_palette(f->count, f->orig);
+    wrefresh(f->w);
+    ret |= fade_destroy(f);
+  }
+  return ret;
+}
+
+int fade_destroy(fade* f){
+  if(f){
+    close(f->fd);
+    release_fade(f);
+    free(f);
+  }
+  return 0;
+}
 
 int fadeout(WINDOW* w, unsigned ms){
-  uint64_t nanosecs_total;
-  uint64_t nanosecs_step;
   outcurses_rgb* orig;
   outcurses_rgb maxes;
-  int maxsteps;
-  outcurses_rgb* cur;
+  outcurses_rgb* black;
   int ret;
 
   ret = -1;
-  if(alloc_palette(COLORS, &orig, &cur)){
+  if(alloc_palette(COLORS, &orig, &black)){
     goto done;
   }
-  // Retrieve current palette, and extract component maxima. There is no
-  // point in doing more loop iterations than the maximum component, since
-  // the smallest action we can take is subtracting 1 from the largest value.
+  // Retrieve current palette, and extract component maxima.
   if(retrieve_palette(COLORS, orig, &maxes, false)){
     goto done;
   }
-  maxsteps = maxes.g > maxes.r ? (maxes.b > maxes.g ? maxes.b : maxes.g) :
-         (maxes.b > maxes.r ? maxes.b : maxes.r);
-  if(maxsteps < 1){ // no colors in use? more likely an error
+  if(maxes.r < 1 && maxes.g < 1 && maxes.b < 1){
+    goto done; // no colors in use? more likely an error
+  }
+  memset(black, 0, sizeof(*black) * COLORS);
+  if(fadeto(w, COLORS, orig, black, ms)){
     goto done;
   }
-  memcpy(cur, orig, sizeof(*cur) * COLORS);
-  // We have this many nanoseconds to work through compmax iterations. Our
-  // natural rate might be slower or faster than what's desirable, so at each
-  // iteration, we (a) set the palette to the intensity corresponding to time
-  // since the process started, and (b) sleep if we're early (otherwise we
-  // peg a core unnecessarily).
-  nanosecs_total = ms * NANOSECS_IN_MS;
-  // Number of nanoseconds in an ideal steptime
-  nanosecs_step = nanosecs_total / maxsteps;
-  struct timespec times;
-  clock_gettime(CLOCK_MONOTONIC, &times);
-  // Start time in absolute nanoseconds
-  uint64_t startns = times.tv_sec * NANOSECS_IN_SEC + times.tv_nsec;
-  // Current time, sampled each iteration
-  uint64_t curns;
-  int p;
-  do{
-    clock_gettime(CLOCK_MONOTONIC, &times);
-    curns = times.tv_sec * NANOSECS_IN_SEC + times.tv_nsec;
-    int iter = (curns - startns) / nanosecs_step + 1;
-    if(iter > maxsteps){
-      break;
-    }
-    for(p = 0 ; p < COLORS ; ++p){
-      cur[p].r = orig[p].r * (maxsteps - iter) / maxsteps;
-      cur[p].g = orig[p].g * (maxsteps - iter) / maxsteps;
-      cur[p].b = orig[p].b * (maxsteps - iter) / maxsteps;
-      if(init_extended_color(p, cur[p].r, cur[p].g, cur[p].b) != OK){
-        goto done;
-      }
-    }
-    wrefresh(w);
-    uint64_t nextwake = (iter + 1) * nanosecs_step + startns;
-    struct timespec sleepspec;
-    sleepspec.tv_sec = nextwake / NANOSECS_IN_SEC;
-    sleepspec.tv_nsec = nextwake % NANOSECS_IN_SEC;
-    int r;
-    // clock_nanosleep() has no love for CLOCK_MONOTONIC_RAW, at least as
-    // of Glibc 2.29 + Linux 5.3 :/.
-    r = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &sleepspec, NULL);
-    if(r){
-      goto done;
-    }
-  }while(true);
   if(set_palette(COLORS, orig)){
     goto done;
   }
   reset_color_pairs();
+  reprep_pairs();
   ret = 0;
 
 done:
   free(orig);
-  free(cur);
+  free(black);
   return ret;
 }
 
+int fadein(WINDOW* w, int count, const outcurses_rgb* palette, unsigned ms){
+  outcurses_rgb* black = calloc(count, sizeof(*black));
+  if(black == NULL){
+    return -1;
+  }
+  int ret = fadeto(w, count, black, palette, ms);
+  free(black);
+  return ret;
+}
+
+// A run of cells in a region whose pair was replaced with one using scratch
+// colors, and must be restored afterwards.
+typedef struct remapped {
+  int y, x, len;
+  attr_t attrs;
+  int pair;        // original pair
+} remapped;
+
+// A pair found within the region, and its replacement (if any).
+typedef struct regionpair {
+  int pair;
+  int fg, bg;
+  int newpair;     // pair using scratch colors, or -1 if unneeded
+} regionpair;
+
+// The palette entries a window uses. Those which also appear elsewhere on the
+// screen are replaced by scratch entries (otherwise unused onscreen) within
+// the window, so that fading them doesn't affect anything else.
+typedef struct region {
+  WINDOW* w;
+  outcurses_rgb* palette;  // entire palette upon entry
+  unsigned char* used;     // per color: REGION_INSIDE | REGION_OUTSIDE
+  int* scratch;            // per color: its scratch entry, or -1
+  regionpair* pairs;
+  int paircount, pairalloc;
+  remapped* runs;
+  int runcount, runalloc;
+} region;
+
+#define REGION_INSIDE  0x1
+#define REGION_OUTSIDE 0x2
+#define REGION_FADED   0x4 // inside and not shared, or a scratch entry
+
+static void
+release_region(region* r){
+  int i;
+  for(i = 0 ; i < r->paircount ; ++i){
+    if(r->pairs[i].newpair >= 0){
+      outcurses_pair_release(r->pairs[i].newpair);
+    }
+  }
+  free(r->palette);
+  free(r->used);
+  free(r->scratch);
+  free(r->pairs);
+  free(r->runs);
+}
+
+static inline void
+mark_color(region* r, int color, unsigned char how){
+  if(color >= 0 && color < COLORS){ // the default colors can't be faded
+    r->used[color] |= how;
+  }
+}
+
+// Look up a pair found within the region, adding it if it's new. Windows
+// generally use few distinct pairs, and tend to use them in runs.
+static regionpair*
+region_pair(region* r, int pair){
+  int i;
+  for(i = r->paircount - 1 ; i >= 0 ; --i){
+    if(r->pairs[i].pair == pair){
+      return &r->pairs[i];
+    }
+  }
+  if(r->paircount == r->pairalloc){
+    int n = r->pairalloc ? r->pairalloc * 2 : 16;
+    regionpair* tmp = realloc(r->pairs, sizeof(*tmp) * n);
+    if(tmp == NULL){
+      return NULL;
+    }
+    r->pairs = tmp;
+    r->pairalloc = n;
+  }
+  regionpair* rp = &r->pairs[r->paircount];
+  if(extended_pair_content(pair, &rp->fg, &rp->bg) != OK){
+    return NULL;
+  }
+  rp->pair = pair;
+  rp->newpair = -1;
+  ++r->paircount;
+  mark_color(r, rp->fg, REGION_INSIDE);
+  mark_color(r, rp->bg, REGION_INSIDE);
+  return rp;
+}
+
 static int
-find_palette_max(int count, const outcurses_rgb* palette){
-  int max = 0;
-  while(count--){
-    if(palette[count].r > max){
-      max = palette[count].r;
+cell_pair(WINDOW* w, int y, int x, attr_t* attrs){
+  cchar_t c;
+  wchar_t wch[CCHARW_MAX + 1];
+  short spair;
+  int pair = 0;
+  if(mvwin_wch(w, y, x, &c) != OK){
+    return -1;
+  }
+  if(getcchar(&c, wch, attrs, &spair, &pair) != OK){
+    return -1;
+  }
+  *attrs &= ~A_COLOR;
+  return pair;
+}
+
+static int
+add_run(region* r, int y, int x, attr_t attrs, int pair){
+  if(r->runcount){
+    remapped* last = &r->runs[r->runcount - 1];
+    if(last->y == y && last->x + last->len == x && last->attrs == attrs &&
+       last->pair == pair){
+      ++last->len;
+      return 0;
     }
-    if(palette[count].g > max){
-      max = palette[count].g;
+  }
+  if(r->runcount == r->runalloc){
+    int n = r->runalloc ? r->runalloc * 2 : 64;
+    remapped* tmp = realloc(r->runs, sizeof(*tmp) * n);
+    if(tmp == NULL){
+      return -1;
     }
-    if(palette[count].b > max){
-      max = palette[count].b;
+    r->runs = tmp;
+    r->runalloc = n;
+  }
+  remapped* run = &r->runs[r->runcount++];
+  run->y = y;
+  run->x = x;
+  run->len = 1;
+  run->attrs = attrs;
+  run->pair = pair;
+  return 0;
+}
+
+// Rewrite the runs with their replacement (or original) pairs. Doesn't move
+// the cursor.
+static void
+recolor_runs(region* r, bool restore){
+  int cury, curx, i;
+  getyx(r->w, cury, curx);
+  for(i = 0 ; i < r->runcount ; ++i){
+    const remapped* run = &r->runs[i];
+    int pair = run->pair;
+    if(!restore){
+      pair = region_pair(r, pair)->newpair;
     }
+    mvwchgat(r->w, run->y, run->x, run->len, run->attrs, 0, &pair);
   }
-  return max;
+  wmove(r->w, cury, curx);
 }
 
-int fadein(WINDOW* w, int count, const outcurses_rgb* palette, unsigned ms){
-  int max = find_palette_max(count, palette);
-  uint64_t nanosecs_total = ms * NANOSECS_IN_MS;
-  // Number of nanoseconds in an ideal steptime
-  uint64_t nanosecs_step = nanosecs_total / max;
-  struct timespec times;
-  clock_gettime(CLOCK_MONOTONIC, &times);
-  // Start time in absolute nanoseconds
-  uint64_t startns = times.tv_sec * NANOSECS_IN_SEC + times.tv_nsec;
-  // Current time, sampled each iteration
-  uint64_t curns;
-  int ret = -1;
-  int p;
-  outcurses_rgb* cur = malloc(sizeof(*cur) * count);
-  do{
-    clock_gettime(CLOCK_MONOTONIC, &times);
-    curns = times.tv_sec * NANOSECS_IN_SEC + times.tv_nsec;
-    int iter = (curns - startns) / nanosecs_step + 1;
-    if(iter > max){
-      break;
+// Find the colors used within w, and those used elsewhere onscreen (per
+// curscr). Give each shared color a scratch entry, and switch w's cells over
+// to pairs using them. If no scratch entry is available for some shared color,
+// it is faded in place.
+static int
+prep_region(region* r, WINDOW* w){
+  int y, x, c;
+  memset(r, 0, sizeof(*r));
+  r->w = w;
+  if((r->palette = malloc(sizeof(*r->palette) * COLORS)) == NULL ||
+     (r->used = calloc(COLORS, sizeof(*r->used))) == NULL ||
+     (r->scratch = malloc(sizeof(*r->scratch) * COLORS)) == NULL){
+    goto err;
+  }
+  for(c = 0 ; c < COLORS ; ++c){
+    r->scratch[c] = -1;
+  }
+  if(retrieve_palette(COLORS, r->palette, NULL, false)){
+    goto err;
+  }
+  // reading cells moves the cursor, which we mustn't disturb: curscr's cursor
+  // is where ncurses believes the physical cursor to be.
+  int cury, curx, physy, physx;
+  getyx(w, cury, curx);
+  getyx(curscr, physy, physx);
+  int begy, begx, leny, lenx;
+  getbegyx(w, begy, begx);
+  getmaxyx(w, leny, lenx);
+  for(y = 0 ; y < leny ; ++y){
+    for(x = 0 ; x < lenx ; ++x){
+      attr_t attrs;
+      int pair = cell_pair(w, y, x, &attrs);
+      if(pair < 0 || region_pair(r, pair) == NULL){
+        wmove(w, cury, curx);
+        goto err;
+      }
     }
-    for(p = 0 ; p < COLORS ; ++p){
-      cur[p].r = palette[p].r * iter / max;
-      cur[p].g = palette[p].g * iter / max;
-      cur[p].b = palette[p].b * iter / max;
-      if(init_extended_color(p, cur[p].r, cur[p].g, cur[p].b) != OK){
-        goto done;
+  }
+  wmove(w, cury, curx);
+  // the colors used elsewhere onscreen, as last displayed
+  int lastpair = -1;
+  for(y = 0 ; y < getmaxy(curscr) ; ++y){
+    for(x = 0 ; x < getmaxx(curscr) ; ++x){
+      if(y >= begy && y < begy + leny && x >= begx && x < begx + lenx){
+        x = begx + lenx - 1;
+        continue;
+      }
+      attr_t attrs;
+      int cols[2];
+      int pair = cell_pair(curscr, y, x, &attrs);
+      if(pair == lastpair){
+        continue;
+      }
+      if(pair < 0 || extended_pair_content(pair, &cols[0], &cols[1]) != OK){
+        wmove(curscr, physy, physx);
+        goto err;
       }
+      mark_color(r, cols[0], REGION_OUTSIDE);
+      mark_color(r, cols[1], REGION_OUTSIDE);
+      lastpair = pair;
     }
-    wrefresh(w);
-    uint64_t nextwake = (iter + 1) * nanosecs_step + startns;
-    struct timespec sleepspec;
-    sleepspec.tv_sec = nextwake / NANOSECS_IN_SEC;
-    sleepspec.tv_nsec = nextwake % NANOSECS_IN_SEC;
-    int r;
-    // clock_nanosleep() has no love for CLOCK_MONOTONIC_RAW, at least as
-    // of Glibc 2.29 + Linux 5.3 :/.
-    r = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &sleepspec, NULL);
-    if(r){
-      goto done;
+  }
+  wmove(curscr, physy, physx);
+  // assign scratch entries from the top of the palette down
+  int next = COLORS - 1;
+  for(c = 0 ; c < COLORS ; ++c){
+    if(!(r->used[c] & REGION_INSIDE)){
+      continue;
     }
-  }while(true);
-  ret = 0;
+    if(!(r->used[c] & REGION_OUTSIDE)){
+      r->used[c] |= REGION_FADED;
+      continue;
+    }
+    while(next >= 0 && r->used[next]){
+      --next;
+    }
+    if(next < 0){ // out of scratch entries; fade it in place
+      r->used[c] |= REGION_FADED;
+      continue;
+    }
+    r->scratch[c] = next;
+    r->used[next] |= REGION_FADED;
+    if(palette_set(next, &r->palette[c])){
+      goto err;
+    }
+    --next;
+  }
+  // replace pairs referencing shared colors, and note the affected cells
+  int i;
+  for(i = 0 ; i < r->paircount ; ++i){
+    regionpair* rp = &r->pairs[i];
+    int fg = rp->fg >= 0 && r->scratch[rp->fg] >= 0 ? r->scratch[rp->fg] : rp->fg;
+    int bg = rp->bg >= 0 && r->scratch[rp->bg] >= 0 ? r->scratch[rp->bg] : rp->bg;
+    if(fg != rp->fg || bg != rp->bg){
+      if((rp->newpair = outcurses_pair(fg, bg)) < 0){
+        goto err;
+      }
+    }
+  }
+  for(y = 0 ; y < leny ; ++y){
+    for(x = 0 ; x < lenx ; ++x){
+      attr_t attrs;
+      int pair = cell_pair(w, y, x, &attrs);
+      if(region_pair(r, pair)->newpair >= 0){
+        if(add_run(r, y, x, attrs, pair)){
+          wmove(w, cury, curx);
+          goto err;
+        }
+      }
+    }
+  }
+  wmove(w, cury, curx);
+  recolor_runs(r, false);
+  return 0;
 
-done:
-  free(cur);
+err:
+  for(c = 0 ; r->scratch && c < COLORS ; ++c){
+    if(r->scratch[c] >= 0){
+      palette_set(r->scratch[c], &r->palette[r->scratch[c]]);
+    }
+  }
+  release_region(r);
+  return -1;
+}
+
+// Put the window's cells and the scratch entries back as they were.
+static int
+restore_region(region* r){
+  int ret = 0;
+  int c;
+  recolor_runs(r, true);
+  for(c = 0 ; c < COLORS ; ++c){
+    if(r->scratch[c] >= 0){
+      if(palette_set(r->scratch[c], &r->palette[r->scratch[c]])){
+        ret = -1;
+      }
+    }
+  }
+  wrefresh(r->w);
+  release_region(r);
+  return ret;
+}
+
+// Fade the window's colors between their values and black.
+static int
+fade_region(WINDOW* w, unsigned ms, bool out){
+  region r;
+  TRACE_BEGIN("fade_region");
+  if(prep_region(&r, w)){
+    TRACE_END("fade_region");
+    return -1;
+  }
+  int ret = -1;
+  outcurses_rgb* lit = malloc(sizeof(*lit) * COLORS * 2);
+  if(lit){
+    outcurses_rgb* dark = lit + COLORS;
+    int c;
+    for(c = 0 ; c < COLORS ; ++c){
+      lit[c] = dark[c] = r.palette[c];
+      if(r.scratch[c] >= 0){
+        lit[r.scratch[c]] = r.palette[c];
+      }
+    }
+    for(c = 0 ; c < COLORS ; ++c){
+      if(r.used[c] & REGION_FADED){
+        dark[c].r = dark[c].g = dark[c].b = 0;
+      }
+    }
+    if(out){ // like fadeout(), restore the palette afterwards
+      ret = fadeto(w, COLORS, lit, dark, ms);
+      for(c = 0 ; c < COLORS ; ++c){
+        if((r.used[c] & REGION_FADED) && (r.used[c] & REGION_INSIDE)){
+          ret |= palette_set(c, &lit[c]);
+        }
+      }
+    }else{
+      ret = fadeto(w, COLORS, dark, lit, ms);
+    }
+    free(lit);
+  }
+  ret |= restore_region(&r);
+  TRACE_END("fade_region");
   return ret;
 }
+
+int fadeout_region(WINDOW* w, unsigned ms){
+  return fade_region(w, ms, true);
+}
+
+int fadein_region(WINDOW* w, unsigned ms){
+  return fade_region(w, ms, false);
+}
@@ -0,0 +1,829 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <wchar.h>
+#include <pthread.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include "outcurses.h"
+#include "headless.h"
+
+// Headless mode runs ncurses atop an in-process pseudoterminal. A thread reads
+// everything emitted from the master side, and feeds it to a small VT/ANSI
+// state machine tracking the screen contents, from which we derive how many
+// bytes, sequences, and cell changes each frame actually cost.
+
+// SGR attribute bits tracked per cell
+#define VT_BOLD      0x01u
+#define VT_DIM       0x02u
+#define VT_ITALIC    0x04u
+#define VT_UNDERLINE 0x08u
+#define VT_BLINK     0x10u
+#define VT_REVERSE   0x20u
+#define VT_INVISIBLE 0x40u
+#define VT_STRIKE    0x80u
+
+// Direct colors are stored as 24-bit RGB with this bit set. Palette indices
+// are stored as themselves. -1 is the default color.
+#define VT_DIRECTCOLOR 0x1000000
+
+// Written after a frame by outcurses_headless_sample() as an APC string, so
+// that we know when the emulator has caught up. Never counted.
+#define SYNC_SENTINEL "outcurses-sync"
+
+#define VT_MAXPARAMS 16
+
+typedef struct vtcell {
+  wchar_t wc;        // L' ' when erased, 0 for the right half of a wide glyph
+  int fg, bg;        // -1 for the default color
+  unsigned attrs;    // VT_* bits
+} vtcell;
+
+enum vtstate {
+  VT_GROUND,
+  VT_ESC,            // got ESC
+  VT_ESCINT,         // got ESC plus an intermediate, awaiting final byte
+  VT_CSI,            // control sequence
+  VT_STRING,         // OSC, DCS, APC, PM, or SOS string
+  VT_STRINGESC,      // got ESC within a string, possibly the ST
+};
+
+typedef struct vterm {
+  int rows, cols;
+  vtcell* cells;     // rows * cols
+  int y, x;          // cursor
+  int savedy, savedx;
+  int top, bot;      // scrolling region, inclusive
+  bool wrapnext;     // glyph was written to the last column; wrap before next
+  bool autowrap;     // DECAWM
+  bool acs;          // G0 is DEC special graphics
+  vtcell pen;        // rendition applied to new glyphs (wc unused)
+  wchar_t last;      // last glyph printed, for REP
+  enum vtstate state;
+  char intermediate; // of an ESC or CSI sequence, 0 if none
+  char strkind;      // ']', 'P', '_', '^', or 'X'
+  bool private;      // CSI parameters began with a private marker
+  int params[VT_MAXPARAMS]; // -1 if omitted
+  int pcount;
+  char str[32];      // prefix of the current string, NUL-terminated
+  size_t strlen;
+  size_t seqbytes;   // bytes in the current sequence
+  wchar_t ucs;       // UTF-8 decoding state
+  int utf8left;
+  outcurses_termstats stats; // accumulated since the last sample
+  unsigned syncs;    // sentinels consumed
+} vterm;
+
+static struct {
+  bool active;
+  SCREEN* screen;
+  SCREEN* prev;      // screen current before we started, if any
+  FILE* out;         // ncurses' ends of the pty
+  FILE* in;
+  int master;
+  pthread_t tid;
+  pthread_mutex_t lock; // guards vt, syncreqs, and dead
+  pthread_cond_t cond;  // signaled on sentinel receipt or reader death
+  unsigned syncreqs;
+  bool dead;
+  vterm vt;
+} hl;
+
+static inline vtcell*
+vt_cell(vterm* vt, int y, int x){
+  return &vt->cells[y * vt->cols + x];
+}
+
+static void
+vt_setcell(vterm* vt, int y, int x, const vtcell* c){
+  vtcell* cur = vt_cell(vt, y, x);
+  if(cur->wc != c->wc || cur->fg != c->fg || cur->bg != c->bg ||
+     cur->attrs != c->attrs){
+    *cur = *c;
+    ++vt->stats.cells_changed;
+  }
+}
+
+// erased cells take the current background (back color erase)
+static void
+vt_erase(vterm* vt, int y, int begx, int endx){
+  vtcell blank = { .wc = L' ', .fg = -1, .bg = vt->pen.bg, .attrs = 0, };
+  int x;
+  for(x = begx ; x <= endx ; ++x){
+    vt_setcell(vt, y, x, &blank);
+  }
+}
+
+// scroll rows [top, bot] up by n, blanking at the bottom
+static void
+vt_scrollup(vterm* vt, int top, int bot, int n){
+  int y, x;
+  for(y = top ; y <= bot ; ++y){
+    if(y + n <= bot){
+      for(x = 0 ; x < vt->cols ; ++x){
+        vt_setcell(vt, y, x, vt_cell(vt, y + n, x));
+      }
+    }else{
+      vt_erase(vt, y, 0, vt->cols - 1);
+    }
+  }
+}
+
+// scroll rows [top, bot] down by n, blanking at the top
+static void
+vt_scrolldown(vterm* vt, int top, int bot, int n){
+  int y, x;
+  for(y = bot ; y >= top ; --y){
+    if(y - n >= top){
+      for(x = 0 ; x < vt->cols ; ++x){
+        vt_setcell(vt, y, x, vt_cell(vt, y - n, x));
+      }
+    }else{
+      vt_erase(vt, y, 0, vt->cols - 1);
+    }
+  }
+}
+
+static void
+vt_linefeed(vterm* vt){
+  if(vt->y == vt->bot){
+    vt_scrollup(vt, vt->top, vt->bot, 1);
+  }else if(vt->y < vt->rows - 1){
+    ++vt->y;
+  }
+}
+
+static void
+vt_reverseindex(vterm* vt){
+  if(vt->y == vt->top){
+    vt_scrolldown(vt, vt->top, vt->bot, 1);
+  }else if(vt->y > 0){
+    --vt->y;
+  }
+}
+
+static void
+vt_moveto(vterm* vt, int y, int x){
+  vt->y = y < 0 ? 0 : y >= vt->rows ? vt->rows - 1 : y;
+  vt->x = x < 0 ? 0 : x >= vt->cols ? vt->cols - 1 : x;
+  vt->wrapnext = false;
+}
+
+static void
+vt_reset(vterm* vt){
+  vt->pen.fg = vt->pen.bg = -1;
+  vt->pen.attrs = 0;
+  vt->top = 0;
+  vt->bot = vt->rows - 1;
+  vt->autowrap = true;
+  vt->acs = false;
+  vt->savedy = vt->savedx = 0;
+  vt_moveto(vt, 0, 0);
+  int y;
+  for(y = 0 ; y < vt->rows ; ++y){
+    vt_erase(vt, y, 0, vt->cols - 1);
+  }
+}
+
+// DEC special graphics, as selected by ESC ( 0, for 0x60..0x7e
+static const wchar_t vt_decgraphics[] =
+  L"◆▒␉␌␍␊°±␤␋┘┐┌└┼⎺⎻─⎼⎽├┤┴┬│≤≥π≠£·";
+
+static void
+vt_print(vterm* vt, wchar_t wc){
+  if(vt->acs && wc >= 0x60 && wc <= 0x7e){
+    wc = vt_decgraphics[wc - 0x60];
+  }
+  int width = wcwidth(wc);
+  if(width == 0){ // combining character; no cell of its own
+    ++vt->stats.glyphs;
+    return;
+  }
+  if(width < 0 || width > vt->cols){
+    width = 1;
+  }
+  if(vt->wrapnext && vt->autowrap){
+    vt->x = 0;
+    vt_linefeed(vt);
+  }
+  vt->wrapnext = false;
+  if(vt->x + width > vt->cols){
+    if(vt->autowrap){
+      vt->x = 0;
+      vt_linefeed(vt);
+    }else{
+      vt->x = vt->cols - width;
+    }
+  }
+  vtcell c = vt->pen;
+  c.wc = wc;
+  vt_setcell(vt, vt->y, vt->x, &c);
+  if(width == 2){
+    c.wc = 0;
+    vt_setcell(vt, vt->y, vt->x + 1, &c);
+  }
+  ++vt->stats.glyphs;
+  vt->last = wc;
+  if(vt->x + width >= vt->cols){
+    vt->x = vt->cols - 1;
+    vt->wrapnext = vt->autowrap;
+  }else{
+    vt->x += width;
+  }
+}
+
+static void
+vt_control(vterm* vt, unsigned char c){
+  ++vt->stats.controls;
+  switch(c){
+    case '\r': vt->x = 0; vt->wrapnext = false; break;
+    case '\n': case '\v': case '\f': vt_linefeed(vt); vt->wrapnext = false; break;
+    case '\b': if(vt->x > 0){ --vt->x; } vt->wrapnext = false; break;
+    case '\t': vt_moveto(vt, vt->y, (vt->x / 8 + 1) * 8); break;
+    default: break; // BEL, SO, SI, NUL, etc.
+  }
+}
+
+// parameter idx, or def if it was omitted or zero
+static inline int
+vt_param(const vterm* vt, int idx, int def){
+  if(idx >= vt->pcount || vt->params[idx] <= 0){
+    return def;
+  }
+  return vt->params[idx];
+}
+
+static void
+vt_sgr(vterm* vt){
+  int i;
+  if(vt->pcount == 0){
+    vt->pen.fg = vt->pen.bg = -1;
+    vt->pen.attrs = 0;
+    return;
+  }
+  for(i = 0 ; i < vt->pcount ; ++i){
+    int p = vt->params[i] < 0 ? 0 : vt->params[i];
+    int* target = NULL;
+    switch(p){
+      case 0: vt->pen.fg = vt->pen.bg = -1; vt->pen.attrs = 0; break;
+      case 1: vt->pen.attrs |= VT_BOLD; break;
+      case 2: vt->pen.attrs |= VT_DIM; break;
+      case 3: vt->pen.attrs |= VT_ITALIC; break;
+      case 4: vt->pen.attrs |= VT_UNDERLINE; break;
+      case 5: vt->pen.attrs |= VT_BLINK; break;
+      case 7: vt->pen.attrs |= VT_REVERSE; break;
+      case 8: vt->pen.attrs |= VT_INVISIBLE; break;
+      case 9: vt->pen.attrs |= VT_STRIKE; break;
+      case 22: vt->pen.attrs &= ~(VT_BOLD | VT_DIM); break;
+      case 23: vt->pen.attrs &= ~VT_ITALIC; break;
+      case 24: vt->pen.attrs &= ~VT_UNDERLINE; break;
+      case 25: vt->pen.attrs &= ~VT_BLINK; break;
+      case 27: vt->pen.attrs &= ~VT_REVERSE; break;
+      case 28: vt->pen.attrs &= ~VT_INVISIBLE; break;
+      case 29: vt->pen.attrs &= ~VT_STRIKE; break;
+      case 38: target = &vt->pen.fg; break;
+      case 39: vt->pen.fg = -1; break;
+      case 48: target = &vt->pen.bg; break;
+      case 49: vt->pen.bg = -1; break;
+      default:
+        if(p >= 30 && p <= 37){
+          vt->pen.fg = p - 30;
+        }else if(p >= 40 && p <= 47){
+          vt->pen.bg = p - 40;
+        }else if(p >= 90 && p <= 97){
+          vt->pen.fg = p - 90 + 8;
+        }else if(p >= 100 && p <= 107){
+          vt->pen.bg = p - 100 + 8;
+        }
+        break;
+    }
+    if(target){ // 38/48 ; 5 ; index or 38/48 ; 2 ; r ; g ; b
+      if(vt_param(vt, i + 1, 0) == 5 && i + 2 < vt->pcount){
+        *target = vt_param(vt, i + 2, 0);
+        i += 2;
+      }else if(vt_param(vt, i + 1, 0) == 2 && i + 4 < vt->pcount){
+        *target = VT_DIRECTCOLOR | (vt_param(vt, i + 2, 0) & 0xff) << 16 |
+                  (vt_param(vt, i + 3, 0) & 0xff) << 8 |
+                  (vt_param(vt, i + 4, 0) & 0xff);
+        i += 4;
+      }
+    }
+  }
+}
+
+static void
+vt_csi(vterm* vt, unsigned char final){
+  int n = vt_param(vt, 0, 1);
+  int y, x;
+  if(vt->intermediate){
+    return; // DECSTR and friends; nothing we model
+  }
+  if(vt->private){
+    if(final == 'h' || final == 'l'){
+      int i;
+      for(i = 0 ; i < vt->pcount ; ++i){
+        if(vt->params[i] == 7){
+          vt->autowrap = final == 'h';
+        }
+      }
+    }
+    return;
+  }
+  switch(final){
+    case 'A': vt_moveto(vt, vt->y - n, vt->x); break;
+    case 'B': case 'e': vt_moveto(vt, vt->y + n, vt->x); break;
+    case 'C': case 'a': vt_moveto(vt, vt->y, vt->x + n); break;
+    case 'D': vt_moveto(vt, vt->y, vt->x - n); break;
+    case 'E': vt_moveto(vt, vt->y + n, 0); break;
+    case 'F': vt_moveto(vt, vt->y - n, 0); break;
+    case 'G': case '`': vt_moveto(vt, vt->y, n - 1); break;
+    case 'd': vt_moveto(vt, n - 1, vt->x); break;
+    case 'H': case 'f': vt_moveto(vt, n - 1, vt_param(vt, 1, 1) - 1); break;
+    case 'J':
+      switch(vt->pcount ? vt->params[0] : 0){
+        case -1: case 0:
+          vt_erase(vt, vt->y, vt->x, vt->cols - 1);
+          for(y = vt->y + 1 ; y < vt->rows ; ++y){
+            vt_erase(vt, y, 0, vt->cols - 1);
+          }
+          break;
+        case 1:
+          for(y = 0 ; y < vt->y ; ++y){
+            vt_erase(vt, y, 0, vt->cols - 1);
+          }
+          vt_erase(vt, vt->y, 0, vt->x);
+          break;
+        default:
+          for(y = 0 ; y < vt->rows ; ++y){
+            vt_erase(vt, y, 0, vt->cols - 1);
+          }
+          break;
+      }
+      break;
+    case 'K':
+      switch(vt->pcount ? vt->params[0] : 0){
+        case -1: case 0: vt_erase(vt, vt->y, vt->x, vt->cols - 1); break;
+        case 1: vt_erase(vt, vt->y, 0, vt->x); break;
+        default: vt_erase(vt, vt->y, 0, vt->cols - 1); break;
+      }
+      break;
+    case 'X':
+      x = vt->x + n - 1;
+      vt_erase(vt, vt->y, vt->x, x >= vt->cols ? vt->cols - 1 : x);
+      break;
+    case '@': // ICH
+      for(x = vt->cols - 1 ; x >= vt->x + n ; --x){
+        vt_setcell(vt, vt->y, x, vt_cell(vt, vt->y, x - n));
+      }
+      x = vt->x + n - 1;
+      vt_erase(vt, vt->y, vt->x, x >= vt->cols ? vt->cols - 1 : x);
+      break;
+    case 'P': // DCH
+      for(x = vt->x ; x + n < vt->cols ; ++x){
+        vt_setcell(vt, vt->y, x, vt_cell(vt, vt->y, x + n));
+      }
+      vt_erase(vt, vt->y, x, vt->cols - 1);
+      break;
+    case 'L':
+      if(vt->y >= vt->top && vt->y <= vt->bot){
+        vt_scrolldown(vt, vt->y, vt->bot, n);
+        vt_moveto(vt, vt->y, 0);
+      }
+      break;
+    case 'M':
+      if(vt->y >= vt->top && vt->y <= vt->bot){
+        vt_scrollup(vt, vt->y, vt->bot, n);
+        vt_moveto(vt, vt->y, 0);
+      }
+      break;
+    case 'S': vt_scrollup(vt, vt->top, vt->bot, n); break;
+    case 'T': vt_scrolldown(vt, vt->top, vt->bot, n); break;
+    case 'r':
+      y = vt_param(vt, 0, 1) - 1;
+      x = vt_param(vt, 1, vt->rows) - 1; // bottom row, really
+      if(x >= vt->rows){
+        x = vt->rows - 1;
+      }
+      if(y < x){
+        vt->top = y;
+        vt->bot = x;
+        vt_moveto(vt, 0, 0);
+      }
+      break;
+    case 'm': vt_sgr(vt); break;
+    case 'b':
+      while(n-- > 0){
+        vt_print(vt, vt->last);
+      }
+      break;
+    case 's': vt->savedy = vt->y; vt->savedx = vt->x; break;
+    case 'u': vt_moveto(vt, vt->savedy, vt->savedx); break;
+    default: break; // modes, reports, window ops...
+  }
+}
+
+static void
+vt_esc(vterm* vt, unsigned char c){
+  vt->state = VT_GROUND;
+  switch(c){
+    case '[':
+      vt->state = VT_CSI;
+      vt->pcount = 0;
+      vt->private = false;
+      vt->intermediate = 0;
+      return;
+    case ']': case 'P': case '_': case '^': case 'X':
+      vt->state = VT_STRING;
+      vt->strkind = c;
+      vt->strlen = 0;
+      vt->str[0] = '\0';
+      return;
+    case '(': case ')': case '*': case '+': case '#': case '%': case ' ':
+      vt->state = VT_ESCINT;
+      vt->intermediate = c;
+      return;
+    case '7': vt->savedy = vt->y; vt->savedx = vt->x; break;
+    case '8': vt_moveto(vt, vt->savedy, vt->savedx); break;
+    case 'D': vt_linefeed(vt); break;
+    case 'E': vt->x = 0; vt_linefeed(vt); break;
+    case 'M': vt_reverseindex(vt); break;
+    case 'c': vt_reset(vt); break;
+    default: break; // keypad modes, etc.
+  }
+  ++vt->stats.escapes;
+}
+
+static void
+vt_endstring(vterm* vt){
+  vt->state = VT_GROUND;
+  if(vt->strkind == '_' && strcmp(vt->str, SYNC_SENTINEL) == 0){
+    vt->stats.bytes -= vt->seqbytes;
+    ++vt->syncs;
+    return;
+  }
+  ++vt->stats.escapes;
+}
+
+static void
+vt_utf8(vterm* vt, unsigned char c){
+  if(c < 0x80){
+    vt->utf8left = 0;
+    vt_print(vt, c);
+  }else if(c < 0xc0){
+    if(vt->utf8left){
+      vt->ucs = (vt->ucs << 6) | (c & 0x3f);
+      if(--vt->utf8left == 0){
+        vt_print(vt, vt->ucs);
+      }
+    }else{
+      vt_print(vt, 0xfffd);
+    }
+  }else if(c < 0xe0){
+    vt->ucs = c & 0x1f;
+    vt->utf8left = 1;
+  }else if(c < 0xf0){
+    vt->ucs = c & 0x0f;
+    vt->utf8left = 2;
+  }else if(c < 0xf8){
+    vt->ucs = c & 0x07;
+    vt->utf8left = 3;
+  }else{
+    vt->utf8left = 0;
+    vt_print(vt, 0xfffd);
+  }
+}
+
+static void
+vt_feed(vterm* vt, unsigned char c){
+  ++vt->stats.bytes;
+  if(vt->state != VT_GROUND){
+    ++vt->seqbytes;
+  }
+  switch(vt->state){
+    case VT_GROUND:
+      if(c == 0x1b){
+        vt->state = VT_ESC;
+        vt->seqbytes = 1;
+      }else if(c < 0x20 || c == 0x7f){
+        vt_control(vt, c);
+      }else{
+        vt_utf8(vt, c);
+      }
+      break;
+    case VT_ESC:
+      if(c == 0x1b){
+        vt->seqbytes = 1;
+      }else{
+        vt_esc(vt, c);
+      }
+      break;
+    case VT_ESCINT:
+      if(vt->intermediate == '('){
+        if(c == '0'){
+          vt->acs = true;
+        }else if(c == 'B'){
+          vt->acs = false;
+        }
+      }
+      vt->intermediate = 0;
+      vt->state = VT_GROUND;
+      ++vt->stats.escapes;
+      break;
+    case VT_CSI:
+      if(c >= '0' && c <= '9'){
+        if(vt->pcount == 0){
+          vt->params[vt->pcount++] = -1;
+        }
+        int* p = &vt->params[vt->pcount - 1];
+        if(*p < 0){
+          *p = 0;
+        }
+        if(*p < 100000){
+          *p = *p * 10 + (c - '0');
+        }
+      }else if(c == ';' || c == ':'){
+        if(vt->pcount == 0){
+          vt->params[vt->pcount++] = -1;
+        }
+        if(vt->pcount < VT_MAXPARAMS){
+          vt->params[vt->pcount++] = -1;
+        }
+      }else if(c >= '<' && c <= '?'){
+        vt->private = true;
+      }else if(c >= 0x20 && c <= 0x2f){
+        vt->intermediate = c;
+      }else if(c >= 0x40 && c <= 0x7e){
+        vt->state = VT_GROUND;
+        ++vt->stats.escapes;
+        vt_csi(vt, c);
+      }else if(c == 0x1b){
+        ++vt->stats.escapes; // abandoned
+        vt->state = VT_ESC;
+        vt->seqbytes = 1;
+      }else if(c < 0x20){
+        vt_control(vt, c);
+      }
+      break;
+    case VT_STRING:
+      if(c == 0x07){
+        vt_endstring(vt);
+      }else if(c == 0x1b){
+        vt->state = VT_STRINGESC;
+      }else if(vt->strlen < sizeof(vt->str) - 1){
+        vt->str[vt->strlen++] = c;
+        vt->str[vt->strlen] = '\0';
+      }
+      break;
+    case VT_STRINGESC:
+      if(c == '\\'){
+        vt_endstring(vt);
+      }else{ // unterminated string, and the start of something new
+        vt_endstring(vt);
+        vt->state = VT_ESC;
+        vt->seqbytes = 2;
+        vt_esc(vt, c);
+      }
+      break;
+  }
+}
+
+static void*
+headless_reader(void* unused){
+  (void)unused;
+  unsigned char buf[BUFSIZ];
+  ssize_t r;
+  // once all slave descriptors have been closed, this returns EIO
+  while((r = read(hl.master, buf, sizeof(buf))) != 0){
+    if(r < 0){
+      if(errno == EINTR){
+        continue;
+      }
+      break;
+    }
+    pthread_mutex_lock(&hl.lock);
+    unsigned syncs = hl.vt.syncs;
+    ssize_t i;
+    for(i = 0 ; i < r ; ++i){
+      vt_feed(&hl.vt, buf[i]);
+    }
+    if(hl.vt.syncs != syncs){
+      pthread_cond_broadcast(&hl.cond);
+    }
+    pthread_mutex_unlock(&hl.lock);
+  }
+  pthread_mutex_lock(&hl.lock);
+  hl.dead = true;
+  pthread_cond_broadcast(&hl.cond);
+  pthread_mutex_unlock(&hl.lock);
+  return NULL;
+}
+
+// Open a pty pair, with the slave in raw mode (so that we see exactly what
+// ncurses wrote) and sized as requested. Returns the slave, or -1.
+static int
+open_pty(int rows, int cols){
+  int slave = -1;
+  hl.master = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+  if(hl.master < 0){
+    return -1;
+  }
+  if(grantpt(hl.master) || unlockpt(hl.master)){
+    goto err;
+  }
+  const char* sname = ptsname(hl.master);
+  if(sname == NULL){
+    goto err;
+  }
+  if((slave = open(sname, O_RDWR | O_NOCTTY | O_CLOEXEC)) < 0){
+    goto err;
+  }
+  struct termios tios;
+  if(tcgetattr(slave, &tios)){
+    goto err;
+  }
+  cfmakeraw(&tios);
+  if(tcsetattr(slave, TCSANOW, &tios)){
+    goto err;
+  }
+  struct winsize ws = { .ws_row = rows, .ws_col = cols, };
+  if(ioctl(slave, TIOCSWINSZ, &ws)){
+    goto err;
+  }
+  return slave;
+
+err:
+  if(slave >= 0){
+    close(slave);
+  }
+  close(hl.master);
+  return -1;
+}
+
+SCREEN* headless_start(const char* termtype, int rows, int cols){
+  if(hl.active){
+    return NULL;
+  }
+  if(termtype == NULL){
+    if((termtype = getenv("TERM")) == NULL){
+      termtype = "xterm-256color";
+    }
+  }
+  if(rows <= 0 || cols <= 0){
+    return NULL;
+  }
+  memset(&hl.vt, 0, sizeof(hl.vt));
+  hl.vt.rows = rows;
+  hl.vt.cols = cols;
+  if((hl.vt.cells = malloc(sizeof(*hl.vt.cells) * rows * cols)) == NULL){
+    return NULL;
+  }
+  // cells_changed counts only differences, so start from a known screen
+  memset(hl.vt.cells, 0, sizeof(*hl.vt.cells) * rows * cols);
+  vt_reset(&hl.vt);
+  memset(&hl.vt.stats, 0, sizeof(hl.vt.stats));
+  int slave = open_pty(rows, cols);
+  if(slave < 0){
+    free(hl.vt.cells);
+    return NULL;
+  }
+  int slavein = dup(slave);
+  hl.out = fdopen(slave, "w");
+  hl.in = slavein < 0 ? NULL : fdopen(slavein, "r");
+  if(hl.out == NULL || hl.in == NULL){
+    goto err;
+  }
+  hl.syncreqs = 0;
+  hl.dead = false;
+  pthread_mutex_init(&hl.lock, NULL);
+  pthread_cond_init(&hl.cond, NULL);
+  if(pthread_create(&hl.tid, NULL, headless_reader, NULL)){
+    pthread_cond_destroy(&hl.cond);
+    pthread_mutex_destroy(&hl.lock);
+    goto err;
+  }
+  hl.prev = set_term(NULL);
+  set_term(hl.prev);
+  if((hl.screen = newterm(termtype, hl.out, hl.in)) == NULL){
+    set_term(hl.prev);
+    fclose(hl.out);
+    fclose(hl.in);
+    pthread_join(hl.tid, NULL);
+    pthread_cond_destroy(&hl.cond);
+    pthread_mutex_destroy(&hl.lock);
+    close(hl.master);
+    free(hl.vt.cells);
+    return NULL;
+  }
+  hl.active = true;
+  return hl.screen;
+
+err:
+  if(hl.out){
+    fclose(hl.out);
+  }else{
+    close(slave);
+  }
+  if(hl.in){
+    fclose(hl.in);
+  }else if(slavein >= 0){
+    close(slavein);
+  }
+  close(hl.master);
+  free(hl.vt.cells);
+  return NULL;
+}
+
+bool headless_active(void){
+  return hl.active;
+}
+
+int headless_fd(void){
+  return hl.active ? fileno(hl.out) : -1;
+}
+
+int headless_stop(void){
+  if(!hl.active){
+    return 0;
+  }
+  if(!isendwin()){
+    endwin();
+  }
+  // delscreen() destroys every window on the global list, including those
+  // of any screen which was current before us. if there was such a screen,
+  // restore it and leak our own.
+  if(hl.prev){
+    set_term(hl.prev);
+  }else{
+    delscreen(hl.screen);
+  }
+  fclose(hl.out);
+  fclose(hl.in);
+  pthread_join(hl.tid, NULL);
+  close(hl.master);
+  pthread_cond_destroy(&hl.cond);
+  pthread_mutex_destroy(&hl.lock);
+  free(hl.vt.cells);
+  hl.vt.cells = NULL;
+  hl.screen = hl.prev = NULL;
+  hl.active = false;
+  return 0;
+}
+
+int outcurses_headless_sample(outcurses_termstats* stats){
+  static const char sentinel[] = "\x1b_" SYNC_SENTINEL "\x1b\\";
+  if(!hl.active){
+    return -1;
+  }
+  pthread_mutex_lock(&hl.lock);
+  unsigned target = ++hl.syncreqs;
+  pthread_mutex_unlock(&hl.lock);
+  // ncurses flushes its own buffer at the end of doupdate(), so anything it
+  // wrote precedes us on the pty.
+  size_t off = 0;
+  while(off < sizeof(sentinel) - 1){
+    ssize_t w = write(fileno(hl.out), sentinel + off, sizeof(sentinel) - 1 - off);
+    if(w < 0){
+      if(errno == EINTR){
+        continue;
+      }
+      return -1;
+    }
+    off += w;
+  }
+  int ret = 0;
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += 5;
+  pthread_mutex_lock(&hl.lock);
+  while((int)(hl.vt.syncs - target) < 0 && !hl.dead){
+    if(pthread_cond_timedwait(&hl.cond, &hl.lock, &deadline) == ETIMEDOUT){
+      break;
+    }
+  }
+  if((int)(hl.vt.syncs - target) < 0){
+    ret = -1;
+  }
+  if(stats){
+    *stats = hl.vt.stats;
+  }
+  memset(&hl.vt.stats, 0, sizeof(hl.vt.stats));
+  pthread_mutex_unlock(&hl.lock);
+  return ret;
+}
+
+int outcurses_headless_cell(int y, int x, wchar_t* wc){
+  int ret = -1;
+  if(!hl.active){
+    return -1;
+  }
+  pthread_mutex_lock(&hl.lock);
+  if(y >= 0 && x >= 0 && y < hl.vt.rows && x < hl.vt.cols){
+    *wc = vt_cell(&hl.vt, y, x)->wc;
+    ret = 0;
+  }
+  pthread_mutex_unlock(&hl.lock);
+  return ret;
+}
@@ -0,0 +1,121 @@
+#include "iseq.h"
+
+static inline size_t
+node_size(const iseqnode* n){
+  return n ? n->size : 0;
+}
+
+// xorshift32; the priorities needn't be unpredictable, only well-distributed
+static inline unsigned
+next_prio(iseq* s){
+  unsigned x = s->seed;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return s->seed = x;
+}
+
+void iseq_init(iseq* s){
+  s->root = NULL;
+  s->seed = 0x9e3779b9u;
+}
+
+// Rotate n above its parent, preserving order and fixing up sizes.
+static void
+rotate_up(iseq* s, iseqnode* n){
+  iseqnode* p = n->parent;
+  iseqnode* g = p->parent;
+  if(p->left == n){
+    if((p->left = n->right)){
+      p->left->parent = p;
+    }
+    n->right = p;
+  }else{
+    if((p->right = n->left)){
+      p->right->parent = p;
+    }
+    n->left = p;
+  }
+  p->parent = n;
+  if((n->parent = g) == NULL){
+    s->root = n;
+  }else if(g->left == p){
+    g->left = n;
+  }else{
+    g->right = n;
+  }
+  n->size = p->size;
+  p->size = 1 + node_size(p->left) + node_size(p->right);
+}
+
+void iseq_insert(iseq* s, iseqnode* n, size_t idx){
+  n->left = n->right = NULL;
+  n->size = 1;
+  n->prio = next_prio(s);
+  iseqnode* parent = NULL;
+  iseqnode** link = &s->root;
+  while(*link){
+    parent = *link;
+    ++parent->size;
+    size_t lsize = node_size(parent->left);
+    if(idx <= lsize){
+      link = &parent->left;
+    }else{
+      idx -= lsize + 1;
+      link = &parent->right;
+    }
+  }
+  *link = n;
+  n->parent = parent;
+  while(n->parent && n->prio < n->parent->prio){
+    rotate_up(s, n);
+  }
+}
+
+void iseq_remove(iseq* s, iseqnode* n){
+  // rotate n down until it has at most one child, then splice it out
+  while(n->left && n->right){
+    rotate_up(s, n->left->prio < n->right->prio ? n->left : n->right);
+  }
+  iseqnode* child = n->left ? n->left : n->right;
+  iseqnode* p = n->parent;
+  if(child){
+    child->parent = p;
+  }
+  if(p == NULL){
+    s->root = child;
+  }else if(p->left == n){
+    p->left = child;
+  }else{
+    p->right = child;
+  }
+  for( ; p ; p = p->parent){
+    --p->size;
+  }
+}
+
+size_t iseq_index(const iseqnode* n){
+  size_t idx = node_size(n->left);
+  for( ; n->parent ; n = n->parent){
+    if(n->parent->right == n){
+      idx += node_size(n->parent->left) + 1;
+    }
+  }
+  return idx;
+}
+
+iseqnode* iseq_at(const iseq* s, size_t idx){
+  iseqnode* n = s->root;
+  while(n){
+    size_t lsize = node_size(n->left);
+    if(idx < lsize){
+      n = n->left;
+    }else if(idx == lsize){
+      break;
+    }else{
+      idx -= lsize + 1;
+      n = n->right;
+    }
+  }
+  return n;
+}
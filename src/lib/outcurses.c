@@ -1,5 +1,55 @@
 #include "outcurses.h"
 #include "colors.h"
+#include "headless.h"
+
+// Shared setup for a freshly-initialized screen. On failure, endwin() has been
+// called, and NULL is returned.
+static WINDOW*
+setup_curses(WINDOW* scr){
+  if(prep_colors()){
+    goto error;
+  }
+  // Sets input to character-at-a-time mode, honoring the terminal driver
+  // (thus things like Ctrl+C will not reach us without raw()).
+  if(cbreak() != OK){
+    fprintf(stderr, "Couldn't set cbreak\n");
+  }
+  // Inhibits input characters from being printed to the screen.
+  if(noecho() != OK){
+    fprintf(stderr, "Couldn't disable echo\n");
+  }
+  // Don't flush output from the tty driver queue upon signal receipt.
+  if(intrflush(scr, FALSE) != OK){
+    fprintf(stderr, "Couldn't disable flush on interrupt\n");
+  }
+  // Inhibits the 'enter' key from advancing input/output on the real screen
+  // (emitting '\n' still has effect on the virtual screen).
+  if(nonl() != OK){
+    fprintf(stderr, "Couldn't disable newline\n");
+    goto error;
+  }
+  // Enable the keypad (pass arrow keys etc. through as composed characters).
+  if(keypad(scr, TRUE) != OK){
+    fprintf(stderr, "Couldn't enable keypad\n");
+    goto error;
+  }
+  // Don't bother moving cursor to refreshed windows, reducing cursor moves.
+  // Note: getsyx() is no longer meaningful when this is set.
+  if(leaveok(scr, TRUE) != OK){
+    fprintf(stderr, "Couldn't disable cursor movement\n");
+    goto error;
+  }
+  // Make the cursor invisible, if supported by the terminal.
+  if(curs_set(0) == ERR){
+    fprintf(stderr, "Couldn't disable cursor\n");
+    goto error;
+  }
+  return scr;
+
+error:
+  endwin();
+  return NULL;
+}
 
 WINDOW* outcurses_init(bool initcurses){
   WINDOW* scr;
@@ -9,44 +59,7 @@ WINDOW* outcurses_init(bool initcurses){
       fprintf(stderr, "Couldn't initialize ncurses\n");
       return NULL;
     }
-    if(prep_colors()){
-      goto error;
-    }
-    // Sets input to character-at-a-time mode, honoring the terminal driver
-    // (thus things like Ctrl+C will not reach us without raw()).
-    if(cbreak() != OK){
-      fprintf(stderr, "Couldn't set cbreak\n");
-    }
-    // Inhibits input characters from being printed to the screen.
-    if(noecho() != OK){
-      fprintf(stderr, "Couldn't disable echo\n");
-    }
-    // Don't flush output from the tty driver queue upon signal receipt.
-    if(intrflush(scr, FALSE) != OK){
-      fprintf(stderr, "Couldn't disable flush on interrupt\n");
-    }
-    // Inhibits the 'enter' key from advancing input/output on the real screen
-    // (emitting '\n' still has effect on the virtual screen).
-    if(nonl() != OK){
-      fprintf(stderr, "Couldn't disable newline\n");
-      goto error;
-    }
-    // Enable the keypad (pass arrow keys etc. through as composed characters).
-    if(keypad(scr, TRUE) != OK){
-      fprintf(stderr, "Couldn't enable keypad\n");
-      goto error;
-    }
-    // Don't bother moving cursor to refreshed windows, reducing cursor moves.
-    // Note: getsyx() is no longer meaningful when this is set.
-    if(leaveok(scr, TRUE) != OK){
-      fprintf(stderr, "Couldn't disable cursor movement\n");
-      goto error;
-    }
-    // Make the cursor invisible, if supported by the terminal.
-    if(curs_set(0) == ERR){
-      fprintf(stderr, "Couldn't disable cursor\n");
-      goto error;
-    }
+    return setup_curses(scr);
   }else{
     if((scr = stdscr) == NULL){
       fprintf(stderr, "Couldn't get stdscr (was ncurses initialized?)\n");
@@ -54,14 +67,27 @@ WINDOW* outcurses_init(bool initcurses){
     }
   }
   return scr;
+}
 
-error:
-  endwin();
-  return NULL;
+WINDOW* outcurses_init_headless(const char* termtype, int rows, int cols){
+  if(headless_start(termtype, rows, cols) == NULL){
+    fprintf(stderr, "Couldn't initialize headless terminal\n");
+    return NULL;
+  }
+  WINDOW* scr = setup_curses(stdscr);
+  if(scr == NULL){
+    headless_stop();
+  }
+  return scr;
 }
 
 int outcurses_stop(bool stopcurses){
   int ret = 0;
+  stop_colors();
+  // we own a headless screen, and tear it down regardless of stopcurses
+  if(headless_active()){
+    return headless_stop();
+  }
   if(stopcurses){
     if(endwin() != OK){
       fprintf(stderr, "Error during endwin()\n");
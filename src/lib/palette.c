@@ -0,0 +1,172 @@
+#include <stdlib.h>
+#include "outcurses.h"
+#include "colors.h"
+
+// The shadow palette remembers every color we've set or queried, so that we
+// needn't ask ncurses again, and needn't write colors which already have the
+// desired value. Terminals with direct color can report COLORS in the
+// millions, so it's a hash table holding only the entries we've seen, rather
+// than an array of COLORS.
+typedef struct shadowent {
+  int color;       // -1 if empty
+  outcurses_rgb rgb;
+} shadowent;
+
+static struct {
+  shadowent* ents;
+  unsigned size;   // always a power of 2, or 0
+  unsigned used;
+} shadow;
+
+static inline unsigned
+shadow_hash(int color){
+  return (unsigned)color * 0x9e3779b1u;
+}
+
+// Find color's entry, or the empty entry where it belongs.
+static shadowent*
+shadow_slot(int color){
+  unsigned mask = shadow.size - 1;
+  unsigned i = shadow_hash(color) & mask;
+  while(shadow.ents[i].color >= 0 && shadow.ents[i].color != color){
+    i = (i + 1) & mask;
+  }
+  return &shadow.ents[i];
+}
+
+// Keep the load factor below one half.
+static int
+shadow_grow(void){
+  if(shadow.size && shadow.used * 2 < shadow.size){
+    return 0;
+  }
+  unsigned oldsize = shadow.size;
+  shadowent* old = shadow.ents;
+  unsigned size = oldsize ? oldsize * 2 : 512;
+  shadowent* ents = malloc(sizeof(*ents) * size);
+  if(ents == NULL){
+    return -1;
+  }
+  unsigned i;
+  for(i = 0 ; i < size ; ++i){
+    ents[i].color = -1;
+  }
+  shadow.ents = ents;
+  shadow.size = size;
+  for(i = 0 ; i < oldsize ; ++i){
+    if(old[i].color >= 0){
+      *shadow_slot(old[i].color) = old[i];
+    }
+  }
+  free(old);
+  return 0;
+}
+
+static shadowent*
+shadow_lookup(int color){
+  if(shadow.size == 0){
+    return NULL;
+  }
+  shadowent* e = shadow_slot(color);
+  return e->color >= 0 ? e : NULL;
+}
+
+static int
+shadow_record(int color, const outcurses_rgb* rgb){
+  if(shadow_grow()){
+    return -1;
+  }
+  shadowent* e = shadow_slot(color);
+  if(e->color < 0){
+    e->color = color;
+    ++shadow.used;
+  }
+  e->rgb = *rgb;
+  return 0;
+}
+
+void clear_palette(void){
+  free(shadow.ents);
+  shadow.ents = NULL;
+  shadow.size = 0;
+  shadow.used = 0;
+}
+
+int palette_color(int color, outcurses_rgb* rgb){
+  const shadowent* e = shadow_lookup(color);
+  if(e){
+    *rgb = e->rgb;
+    return 0;
+  }
+  if(extended_color_content(color, &rgb->r, &rgb->g, &rgb->b) != OK){
+    return -1;
+  }
+  shadow_record(color, rgb); // failure only costs us a later query
+  return 0;
+}
+
+int palette_set(int color, const outcurses_rgb* rgb){
+  shadowent* e = shadow_lookup(color);
+  if(e && e->rgb.r == rgb->r && e->rgb.g == rgb->g && e->rgb.b == rgb->b){
+    return 0;
+  }
+  if(init_extended_color(color, rgb->r, rgb->g, rgb->b) != OK){
+    return -1;
+  }
+  if(e){
+    e->rgb = *rgb;
+  }else{
+    shadow_record(color, rgb); // failure only costs us a later query
+  }
+  return 0;
+}
+
+int outcurses_set_color(int color, const outcurses_rgb* rgb){
+  if(color < 0 || color >= COLORS){
+    return -1;
+  }
+  return palette_set(color, rgb);
+}
+
+int retrieve_palette(int count, outcurses_rgb* palette, outcurses_rgb* maxes,
+                     bool zeroout){
+  outcurses_rgb maxes_store;
+  const outcurses_rgb black = { .r = 0, .g = 0, .b = 0, };
+  int p;
+
+  if(maxes == NULL){
+    maxes = &maxes_store;
+  }
+  maxes->r = maxes->g = maxes->b = -1;
+  for(p = 0 ; p < count ; ++p){
+    if(palette_color(p, &palette[p])){
+      return -1;
+    }
+    if(palette[p].r > maxes->r){
+      maxes->r = palette[p].r;
+    }
+    if(palette[p].g > maxes->g){
+      maxes->g = palette[p].g;
+    }
+    if(palette[p].b > maxes->b){
+      maxes->b = palette[p].b;
+    }
+    if(zeroout){
+      if(palette_set(p, &black)){
+        return -1;
+      }
+    }
+  }
+  return 0;
+}
+
+int set_palette(int count, const outcurses_rgb* palette){
+  int p;
+
+  for(p = 0 ; p < count ; ++p){
+    if(palette_set(p, &palette[p])){
+      return -1;
+    }
+  }
+  return 0;
+}
@@ -1,11 +1,18 @@
+#include <time.h>
 #include <errno.h>
 #include <panel.h>
 #include <unistd.h>
+#include <stdint.h>
+#include <sys/timerfd.h>
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
 #include <stdatomic.h>
+#include <pthread.h>
 #include "outcurses.h"
+#include "iseq.h"
+#include "trace.h"
 
 // Tablets are the toplevel entitites within a panelreel. Each corresponds to
 // a single, distinct PANEL.
@@ -13,10 +20,58 @@ typedef struct tablet {
   PANEL* p;                    // visible panel, NULL when offscreen
   struct tablet* next;
   struct tablet* prev;
+  iseqnode seq;                // our position within the reel
+  struct tablet* shownext;     // tablets having panels, so that we needn't
+  struct tablet* showprev;     //  walk the entire reel to find them
   tabletcb cbfxn;              // application callback to draw tablet
+  tabletmeasurecb measurecb;   // optional application callback to size tablet
   void* curry;                 // application data provided to cbfxn
+  atomic_bool dirty;           // touched since the callback last ran
+  atomic_bool queued;          // on the reel's pending stack
+  struct tablet* pendnext;     // next on the pending stack
+  bool ontouched;              // on the reel's touched list
+  struct tablet* touchnext;    // next on the touched list
+  // cached from the last time we were drawn, so that an untouched tablet can
+  // be placed again without invoking its callback
+  int cblines;                 // lines returned by the callback
+  bool cbdir;                  // cliptop as provided to the callback
+  bool natural;                // unclipped, with room to spare
+  bool focusborder;            // borders were drawn in the focused style
+  unsigned gen;                // arrangement in which we were last drawn
+  unsigned char op;            // queued structural change, under oplock
+  struct tablet* opnext;       // next on the reel's op queue
+  struct tablet* opafter;      // placement of a queued add
+  struct tablet* opbefore;
+  bool linked;                 // on the reel; written only by the owner
+  int measured;                // lines returned by measurecb, if set...
+  int measuredcols;            // ...given this many columns
+  // the contents of our window when it was last hidden, if it then held a
+  // complete rendering, so that it can be shown anew without the callback
+  WINDOW* pad;
+  struct tablet* padnext;      // the reel's pad LRU, most recent first
+  struct tablet* padprev;
 } tablet;
 
+// Tablets are carved out of slabs, and returned to a free list upon deletion.
+#define TABLETS_PER_SLAB 64
+
+// Offscreen tablets' pads are retained up to this many bytes of cells, least
+// recently hidden first to go.
+#define PADCACHE_BYTES (4ul << 20)
+
+// Structural changes requested from threads other than the reel's owner.
+enum {
+  TABLET_OP_NONE,
+  TABLET_OP_ADD,
+  TABLET_OP_DEL,
+  TABLET_OP_CANCEL, // deleted before its add was applied
+};
+
+typedef struct tabletslab {
+  struct tabletslab* next;
+  tablet tablets[TABLETS_PER_SLAB];
+} tabletslab;
+
 // The visible screen can be reconstructed from three things:
 //  * which tablet is focused (pointed at by tablets)
 //  * which row the focused tablet starts at (derived from focused window)
@@ -32,6 +87,11 @@ typedef struct panelreel {
   // these values could all be derived at any time, but keeping them computed
   // makes other things easier, or saves us time (at the cost of complexity).
   int tabletcount;         // could be derived, but we keep it o(1)
+  // the tablets in order, starting from the first one added, for positional
+  // lookup. next/prev agree with it, modulo wrapping around.
+  iseq seq;
+  tablet* shown;           // tablets having panels, in no particular order
+  int showncount;          // length of the shown list
   // last direction in which we moved. positive if we moved down ("next"),
   // negative if we moved up ("prev"), 0 for non-linear operation. we start
   // drawing unfocused tablets opposite the direction of our last movement, so
@@ -41,8 +101,62 @@ typedef struct panelreel {
   // differently when the reel is not completely filled. ideally we'd unite the
   // two modes, but for now, check this bool and take one of two paths.
   bool all_visible;
+  // panelreel_touch() pushes onto pending, a lock-free stack, writing efd only
+  // when it was empty. the UI thread takes the entire stack at once, moving
+  // its tablets to the (private) touched list, from which they're drained.
+  _Atomic(tablet*) pending;
+  tablet* touched;
+  bool drained_visible;    // panelreel_drain_touched() gave up a drawn tablet
+  // PANELs of tablets which went offscreen or were deleted, hidden and
+  // awaiting reuse, so that scrolling needn't create and destroy windows.
+  PANEL** pool;
+  int poolcount, poolalloc;
+  tablet* pads;            // tablets having pads, most recently hidden first
+  tablet* padtail;
+  // adds and deletions from other threads are queued on ops, and applied by
+  // the owner (the creating thread) before it next updates or redraws the
+  // reel. oplock guards only the queue and the tablet allocator, and is never
+  // held while laying out or drawing, so producers don't wait on frames.
+  pthread_t owner;
+  pthread_mutex_t oplock;
+  tablet* ops;             // FIFO, linked through opnext
+  tablet** opstail;
+  atomic_bool opsqueued;   // ops is non-empty; checked without the lock
+  tabletslab* slabs;
+  tablet* freetablets;     // linked through next
+  panelreel_stats stats;
+  atomic_ulong touches;    // panelreel_touch() calls, from any thread
+  unsigned gen;            // incremented with each arrangement
+  int batch;               // depth of panelreel_begin_batch() nesting
+  bool deferred;           // rendering was suppressed (batch or scheduler)
+  uint64_t resized;        // ns of the latest resize not yet laid out, or 0
+  struct panelreel_sched* sched; // paces rendering, if attached
 } panelreel;
 
+#define NANOSECS_IN_SEC 1000000000ull
+
+// With a scheduler attached, a resize is laid out only once no other has
+// arrived for this long, so that a storm of them costs one layout.
+#define RESIZE_QUIET_NS (NANOSECS_IN_SEC / 10)
+
+static inline uint64_t
+monotonic_ns(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * NANOSECS_IN_SEC + ts.tv_nsec;
+}
+
+// A scheduler renders its reel upon a timerfd, armed (once) by the first
+// render following a frame, and no sooner than a frame interval after it.
+// Nothing is armed while the reel is untouched.
+typedef struct panelreel_sched {
+  panelreel* pr;
+  int fd;                  // CLOCK_MONOTONIC timerfd
+  uint64_t interval;       // minimum ns between frames, 0 for no limit
+  uint64_t lastframe;      // CLOCK_MONOTONIC ns at the last frame
+  bool armed;
+} panelreel_sched;
+
 // Returns the starting coordinates (relative to the screen) of the specified
 // window, and its length. End is (begx + lenx - 1, begy + leny - 1).
 static inline void
@@ -90,13 +204,16 @@ draw_borders(WINDOW* w, unsigned nobordermask, attr_t attr, int pair,
       }
     }
   }
-  int y;
-  for(y = begy + !cliphead ; y < maxy + !!clipfoot ; ++y){
+  // the sides are drawn a column at a time, like the top and bottom rows.
+  // writing them a cell at a time costs a call (and its rendering) per row.
+  int y = begy + !cliphead;
+  int sidelen = maxy + !!clipfoot - y;
+  if(sidelen > 0){
     if(!(nobordermask & BORDERMASK_LEFT)){
-      ret |= mvwadd_wch(w, y, begx, WACS_VLINE);
+      ret |= mvwvline_set(w, y, begx, WACS_VLINE, sidelen);
     }
     if(!(nobordermask & BORDERMASK_RIGHT)){
-      ret |= mvwadd_wch(w, y, maxx, WACS_VLINE);
+      ret |= mvwvline_set(w, y, maxx, WACS_VLINE, sidelen);
     }
   }
   if(!clipfoot){
@@ -194,6 +311,440 @@ tablet_columns(const panelreel* pr, int* begx, int* begy, int* lenx, int* leny,
   return 0;
 }
 
+// Memory held by a window's cells.
+static inline unsigned long
+window_bytes(const WINDOW* w){
+  return (unsigned long)getmaxy(w) * getmaxx(w) * sizeof(cchar_t);
+}
+
+// The following wrap the curses calls made on tablets' windows and panels,
+// keeping count of them.
+static PANEL*
+create_panel(panelreel* pr, int leny, int lenx, int begy, int begx){
+  WINDOW* w;
+  PANEL* p;
+  if((w = newwin(leny, lenx, begy, begx)) == NULL){
+    return NULL;
+  }
+  if((p = new_panel(w)) == NULL){
+    delwin(w);
+    return NULL;
+  }
+  ++pr->stats.panels_created;
+  pr->stats.window_bytes += window_bytes(w);
+  return p;
+}
+
+static void
+destroy_panel(panelreel* pr, PANEL* p){
+  WINDOW* w = panel_window(p);
+  ++pr->stats.panels_destroyed;
+  pr->stats.window_bytes -= window_bytes(w);
+  del_panel(p);
+  delwin(w);
+}
+
+static int
+resize_window(panelreel* pr, WINDOW* w, int leny, int lenx){
+  ++pr->stats.resizes;
+  unsigned long before = window_bytes(w);
+  int ret = wresize(w, leny, lenx);
+  pr->stats.window_bytes += window_bytes(w) - before;
+  return ret;
+}
+
+static inline int
+move_tablet_panel(panelreel* pr, PANEL* p, int y, int x){
+  ++pr->stats.moves;
+  return move_panel(p, y, x);
+}
+
+// Get a PANEL of leny rows and lenx columns at begy/begx for some tablet,
+// recycling a pooled one if possible. Returns NULL on failure.
+static PANEL*
+acquire_panel(panelreel* pr, int leny, int lenx, int begy, int begx){
+  WINDOW* w;
+  PANEL* p;
+  if(pr->poolcount){
+    p = pr->pool[--pr->poolcount];
+    w = panel_window(p);
+    if(resize_window(pr, w, leny, lenx) == OK &&
+       move_tablet_panel(pr, p, begy, begx) == OK){
+      // make it look like a fresh window
+      wbkgdset(w, ' ');
+      wattr_set(w, A_NORMAL, 0, NULL);
+      werase(w);
+      show_panel(p);
+      ++pr->stats.pool_hits;
+      return p;
+    }
+    destroy_panel(pr, p); // couldn't be made to fit; discard it
+  }
+  if((p = create_panel(pr, leny, lenx, begy, begx)) == NULL){
+    return NULL;
+  }
+  ++pr->stats.pool_misses;
+  return p;
+}
+
+// Hide a tablet's PANEL, and retain it for reuse. The pool only grows when
+// more panels are offscreen than ever before.
+static void
+release_panel(panelreel* pr, PANEL* p){
+  hide_panel(p);
+  if(pr->poolcount == pr->poolalloc){
+    int newalloc = pr->poolalloc ? pr->poolalloc * 2 : 8;
+    PANEL** tmp = realloc(pr->pool, sizeof(*tmp) * newalloc);
+    if(tmp == NULL){
+      destroy_panel(pr, p);
+      return;
+    }
+    pr->pool = tmp;
+    pr->poolalloc = newalloc;
+  }
+  pr->pool[pr->poolcount++] = p;
+}
+
+// Give a tablet a panel, tracking it on the shown list.
+static void
+show_tablet(panelreel* pr, tablet* t, PANEL* p){
+  t->p = p;
+  t->showprev = NULL;
+  if((t->shownext = pr->shown)){
+    t->shownext->showprev = t;
+  }
+  pr->shown = t;
+  ++pr->showncount;
+}
+
+// Release a tablet's panel, if it has one.
+static void
+hide_tablet(panelreel* pr, tablet* t){
+  if(t->p == NULL){
+    return;
+  }
+  release_panel(pr, t->p);
+  t->p = NULL;
+  if(t->shownext){
+    t->shownext->showprev = t->showprev;
+  }
+  if(t->showprev){
+    t->showprev->shownext = t->shownext;
+  }else{
+    pr->shown = t->shownext;
+  }
+  --pr->showncount;
+}
+
+static void
+unlink_pad(panelreel* pr, tablet* t){
+  if(t->padnext){
+    t->padnext->padprev = t->padprev;
+  }else{
+    pr->padtail = t->padprev;
+  }
+  if(t->padprev){
+    t->padprev->padnext = t->padnext;
+  }else{
+    pr->pads = t->padnext;
+  }
+}
+
+// Discard a tablet's pad, if it has one. It's no longer a valid rendering.
+static void
+drop_pad(panelreel* pr, tablet* t){
+  if(t->pad == NULL){
+    return;
+  }
+  unlink_pad(pr, t);
+  pr->stats.pad_bytes -= window_bytes(t->pad);
+  delwin(t->pad);
+  t->pad = NULL;
+}
+
+// Copy a tablet's window to its pad, making it the most recently used, and
+// evict the least recently used pads beyond PADCACHE_BYTES.
+static void
+stash_pad(panelreel* pr, tablet* t){
+  WINDOW* w = panel_window(t->p);
+  if(t->pad){
+    unlink_pad(pr, t);
+    if(getmaxy(t->pad) != getmaxy(w) || getmaxx(t->pad) != getmaxx(w)){
+      pr->stats.pad_bytes -= window_bytes(t->pad);
+      delwin(t->pad);
+      t->pad = NULL;
+    }
+  }
+  if(t->pad == NULL){
+    if((t->pad = newpad(getmaxy(w), getmaxx(w))) == NULL){
+      return;
+    }
+    pr->stats.pad_bytes += window_bytes(t->pad);
+  }
+  if(copywin(w, t->pad, 0, 0, 0, 0, getmaxy(w) - 1, getmaxx(w) - 1,
+             false) != OK){
+    pr->stats.pad_bytes -= window_bytes(t->pad);
+    delwin(t->pad);
+    t->pad = NULL;
+    return;
+  }
+  t->padprev = NULL;
+  if((t->padnext = pr->pads)){
+    t->padnext->padprev = t;
+  }else{
+    pr->padtail = t;
+  }
+  pr->pads = t;
+  while(pr->stats.pad_bytes > PADCACHE_BYTES && pr->padtail != t){
+    drop_pad(pr, pr->padtail);
+  }
+}
+
+// Hide a tablet which has gone offscreen. If its window holds a complete,
+// current rendering, keep a copy in its pad.
+static void
+stash_tablet(panelreel* pr, tablet* t){
+  if(t->p == NULL){
+    return;
+  }
+  if(t->natural && !atomic_load(&t->dirty)){
+    stash_pad(pr, t);
+  }else{
+    drop_pad(pr, t);
+  }
+  hide_tablet(pr, t);
+}
+
+static inline tablet*
+tablet_of(iseqnode* n){
+  return n ? (tablet*)((char*)n - offsetof(tablet, seq)) : NULL;
+}
+
+// Safe to call from any thread.
+static tablet*
+alloc_tablet(panelreel* pr){
+  pthread_mutex_lock(&pr->oplock);
+  if(pr->freetablets == NULL){
+    tabletslab* slab = malloc(sizeof(*slab));
+    if(slab == NULL){
+      pthread_mutex_unlock(&pr->oplock);
+      return NULL;
+    }
+    slab->next = pr->slabs;
+    pr->slabs = slab;
+    int i;
+    for(i = TABLETS_PER_SLAB - 1 ; i >= 0 ; --i){
+      slab->tablets[i].linked = false;
+      slab->tablets[i].next = pr->freetablets;
+      pr->freetablets = &slab->tablets[i];
+    }
+    ++pr->stats.slab_misses;
+  }else{
+    ++pr->stats.slab_hits;
+  }
+  tablet* t = pr->freetablets;
+  pr->freetablets = t->next;
+  pthread_mutex_unlock(&pr->oplock);
+  return t;
+}
+
+// Only the owner frees tablets.
+static inline void
+free_tablet(panelreel* pr, tablet* t){
+  t->linked = false;
+  pthread_mutex_lock(&pr->oplock);
+  t->next = pr->freetablets;
+  pr->freetablets = t;
+  pthread_mutex_unlock(&pr->oplock);
+}
+
+// The lines a measured tablet will occupy, given cbrows rows.
+static inline int
+measured_lines(const tablet* t, int cbrows){
+  if(t->measured < 0){
+    return 0;
+  }
+  return t->measured < cbrows ? t->measured : cbrows;
+}
+
+// An untouched tablet which last rendered in full, with room to spare, will
+// render identically given at least as much room, in the same direction, at
+// the same width. It can be placed without invoking its callback. A measured
+// tablet can be placed so long as it would occupy the same lines, clipped or
+// not.
+static inline bool
+rendering_reusable(const tablet* t, const WINDOW* w, int lenx, int cbrows,
+                   bool cbdir){
+  if(atomic_load(&t->dirty) || t->cbdir != cbdir || getmaxx(w) != lenx){
+    return false;
+  }
+  if(t->measurecb){
+    int lines = measured_lines(t, cbrows);
+    return lines == t->cblines && (lines < cbrows) == t->natural;
+  }
+  return t->natural && t->cblines < cbrows;
+}
+
+// Is the tablet's window reusable? See rendering_reusable().
+static inline bool
+tablet_reusable(const tablet* t, int lenx, int cbrows, bool cbdir){
+  return t->p && rendering_reusable(t, panel_window(t->p), lenx, cbrows, cbdir);
+}
+
+// Given the lines a tablet's callback used (or will use), determine the height
+// and first row of its window, and whether its head or foot is clipped. The
+// other arguments are as provided to panelreel_draw_tablet(), plus begy and
+// leny as returned by tablet_columns().
+static void
+tablet_geometry(const panelreel* pr, int lines, int frontiery, int direction,
+                int begy, int leny, int* rows, int* y,
+                bool* cliphead, bool* clipfoot){
+  *cliphead = *clipfoot = false;
+  *rows = leny;
+  *y = begy;
+  if(lines == leny){
+    return;
+  }
+  if(lines == leny - 1){ // only has one border visible (partially off-screen)
+    if(direction < 0){
+      *rows = lines + !(pr->popts.tabletmask & BORDERMASK_BOTTOM);
+      *cliphead = true;
+    }else{
+      *rows = lines + !(pr->popts.tabletmask & BORDERMASK_TOP);
+      *clipfoot = true;
+    }
+  }else{ // both borders are visible
+    *rows = lines + !(pr->popts.tabletmask & BORDERMASK_BOTTOM) +
+            !(pr->popts.tabletmask & BORDERMASK_TOP);
+  }
+  if(direction < 0){
+    *y = begy + leny - *rows;
+  }else if(direction == 0){
+    // The focused tablet ought move as little as possible. Keep it at the
+    // frontier, or the nearest line above if it has grown.
+    *y = frontiery;
+    if(leny - frontiery + 1 < *rows){
+      *y = leny - *rows + getbegy(panel_window(pr->p));
+    }
+  }
+}
+
+// Place a reusable tablet where panelreel_draw_tablet() would have put it had
+// the callback been invoked, and refresh its borders (the focus might have
+// changed). begy, begx, and leny are as returned by tablet_columns().
+static int
+place_tablet(panelreel* pr, tablet* t, int frontiery, int direction,
+             int begy, int begx, int leny){
+  WINDOW* w = panel_window(t->p);
+  int rows, y;
+  bool cliphead, clipfoot;
+  tablet_geometry(pr, t->cblines, frontiery, direction, begy, leny,
+                  &rows, &y, &cliphead, &clipfoot);
+  if(getbegy(w) != y || getbegx(w) != begx){
+    if(move_tablet_panel(pr, t->p, y, begx)){
+      return -1;
+    }
+  }
+  if(t->focusborder != (direction == 0)){
+    t->focusborder = direction == 0;
+    draw_borders(w, pr->popts.tabletmask,
+                 direction == 0 ? pr->popts.focusedattr : pr->popts.tabletattr,
+                 direction == 0 ? pr->popts.focusedpair : pr->popts.tabletpair,
+                 cliphead, clipfoot);
+  }
+  return cliphead || clipfoot;
+}
+
+// Give an offscreen tablet a panel holding the contents of its pad, placed as
+// place_tablet() would. Arguments are as for place_tablet().
+static int
+restore_pad(panelreel* pr, tablet* t, int frontiery, int direction,
+            int begy, int begx, int leny){
+  int rows, y;
+  bool cliphead, clipfoot;
+  tablet_geometry(pr, t->cblines, frontiery, direction, begy, leny,
+                  &rows, &y, &cliphead, &clipfoot);
+  int padrows = getmaxy(t->pad);
+  int padcols = getmaxx(t->pad);
+  if(rows != padrows){
+    return -1;
+  }
+  PANEL* p = acquire_panel(pr, padrows, padcols, y, begx);
+  if(p == NULL){
+    return -1;
+  }
+  show_tablet(pr, t, p);
+  if(copywin(t->pad, panel_window(p), 0, 0, 0, 0, padrows - 1, padcols - 1,
+             false) != OK){
+    hide_tablet(pr, t);
+    return -1;
+  }
+  return 0;
+}
+
+// Draw a tablet having a measure callback. Its geometry is known before the
+// draw callback is invoked, so its window is sized and placed once, and the
+// callback is given exactly the lines it will occupy. Arguments are as for
+// place_tablet(), plus lenx from tablet_columns(), and the rows and columns
+// the draw callback would otherwise have been offered.
+static int
+draw_measured_tablet(panelreel* pr, tablet* t, int frontiery, int direction,
+                     int begy, int begx, int leny, int lenx,
+                     int cbrows, int cbcols){
+  // clear before calling, so that a touch during the callback isn't lost
+  if(atomic_exchange(&t->dirty, false) || t->measuredcols != cbcols){
+    uint64_t start = monotonic_ns();
+    t->measured = t->measurecb(t, cbcols);
+    pr->stats.callback_ns += monotonic_ns() - start;
+    ++pr->stats.measure_callbacks;
+    t->measuredcols = cbcols;
+  }
+  int lines = measured_lines(t, cbrows);
+  int rows, y;
+  bool cliphead, clipfoot;
+  tablet_geometry(pr, lines, frontiery, direction, begy, leny,
+                  &rows, &y, &cliphead, &clipfoot);
+  WINDOW* w;
+  if(t->p == NULL){
+    PANEL* p = acquire_panel(pr, rows, lenx, y, begx);
+    if(p == NULL){
+      return -1;
+    }
+    show_tablet(pr, t, p);
+    w = panel_window(p);
+  }else{
+    w = panel_window(t->p);
+    if(getmaxy(w) != rows || getmaxx(w) != lenx){
+      if(resize_window(pr, w, rows, lenx)){
+        return -1;
+      }
+    }
+    if(getbegy(w) != y || getbegx(w) != begx){
+      if(move_tablet_panel(pr, t->p, y, begx)){
+        return -1;
+      }
+    }
+  }
+  const unsigned mask = pr->popts.tabletmask;
+  int cbx = !(mask & BORDERMASK_LEFT);
+  int cby = !cliphead && !(mask & BORDERMASK_TOP);
+  int cbmaxx = lenx - 1 - !(mask & BORDERMASK_RIGHT);
+  int cbmaxy = rows - 1 - (!clipfoot && !(mask & BORDERMASK_BOTTOM));
+  uint64_t start = monotonic_ns();
+  t->cbfxn(t, cbx, cby, cbmaxx, cbmaxy, direction < 0);
+  pr->stats.callback_ns += monotonic_ns() - start;
+  ++pr->stats.callbacks;
+  t->cblines = lines;
+  t->cbdir = direction < 0;
+  t->natural = lines < cbrows;
+  t->focusborder = direction == 0;
+  draw_borders(w, mask,
+               direction == 0 ? pr->popts.focusedattr : pr->popts.tabletattr,
+               direction == 0 ? pr->popts.focusedpair : pr->popts.tabletpair,
+               cliphead, clipfoot);
+  return cliphead || clipfoot;
+}
+
 // Draw the specified tablet, if possible. A direction less than 0 means we're
 // laying out towards the top. Greater than zero means towards the bottom. 0
 // means this is the focused tablet, always the first one to be drawn.
@@ -206,8 +757,7 @@ tablet_columns(const panelreel* pr, int* begx, int* begy, int* lenx, int* leny,
 // down before displaying it. Destroys any panel if it ought be hidden.
 // Returns 0 if the tablet was able to be wholly rendered, non-zero otherwise.
 static int
-panelreel_draw_tablet(const panelreel* pr, tablet* t, int frontiery,
-                      int direction){
+draw_tablet(panelreel* pr, tablet* t, int frontiery, int direction){
   int lenx, leny, begy, begx;
   WINDOW* w;
   PANEL* fp = t->p;
@@ -216,26 +766,53 @@ panelreel_draw_tablet(const panelreel* pr, tablet* t, int frontiery,
 // fprintf(stderr, "FRONTIER DONE!!!!!!\n");
     if(fp){
 // fprintf(stderr, "HIDING %p at frontier %d (dir %d) with %d\n", t, frontiery, direction, leny);
-      w = panel_window(fp);
-      del_panel(fp);
-      delwin(w);
-      t->p = NULL;
-      update_panels();
+      stash_tablet(pr, t);
     }
     return -1;
   }
 // fprintf(stderr, "tplacement: %p:%p base %d/%d len %d/%d\n", t, fp, begx, begy, lenx, leny);
 // fprintf(stderr, "DRAWING %p at frontier %d (dir %d) with %d\n", t, frontiery, direction, leny);
-  if(fp == NULL){ // create a panel for the tablet
-    w = newwin(leny + 1, lenx, begy, begx);
-    if(w == NULL){
-      return -1;
+  // We pass the coordinates in which the callback may freely write. That's
+  // the full width (minus tablet borders), and the full range of open space
+  // in the direction we're moving. We're not passing *lenghts* to the callback,
+  // but *coordinates* within the window--everywhere save tabletborders.
+  int cby = 0, cbx = 0, cbmaxy = leny, cbmaxx = lenx;
+  --cbmaxy;
+  --cbmaxx;
+  // If we're drawing up, we'll always have a bottom border unless it's masked
+  if(direction < 0 && !(pr->popts.tabletmask & BORDERMASK_BOTTOM)){
+    --cbmaxy;
+  }
+  // If we're drawing down, we'll always have a top border unless it's masked
+  if(direction >= 0 && !(pr->popts.tabletmask & BORDERMASK_TOP)){
+    ++cby;
+  }
+  // Adjust the x-bounds for side borders, which we always have if unmasked
+  cbmaxx -= !(pr->popts.tabletmask & BORDERMASK_RIGHT);
+  cbx += !(pr->popts.tabletmask & BORDERMASK_LEFT);
+  bool cbdir = direction < 0 ? true : false;
+  t->gen = pr->gen;
+  if(tablet_reusable(t, lenx, cbmaxy - cby + 1, cbdir)){
+    return place_tablet(pr, t, frontiery, direction, begy, begx, leny);
+  }
+  if(t->pad && fp == NULL){
+    if(rendering_reusable(t, t->pad, lenx, cbmaxy - cby + 1, cbdir) &&
+       restore_pad(pr, t, frontiery, direction, begy, begx, leny) == 0){
+      ++pr->stats.pad_hits;
+      return place_tablet(pr, t, frontiery, direction, begy, begx, leny);
     }
-    t->p = new_panel(w);
-    if((fp = t->p) == NULL){
-      delwin(w);
+    drop_pad(pr, t);
+  }
+  if(t->measurecb){
+    return draw_measured_tablet(pr, t, frontiery, direction, begy, begx, leny,
+                                lenx, cbmaxy - cby + 1, cbmaxx - cbx + 1);
+  }
+  if(fp == NULL){ // get a panel for the tablet
+    if((fp = acquire_panel(pr, leny + 1, lenx, begy, begx)) == NULL){
       return -1;
     }
+    show_tablet(pr, t, fp);
+    w = panel_window(fp);
   }else{
     w = panel_window(fp);
     int trueby = getbegy(w);
@@ -243,86 +820,48 @@ panelreel_draw_tablet(const panelreel* pr, tablet* t, int frontiery,
     getmaxyx(w, truey, truex);
     if(truey != leny){
 // fprintf(stderr, "RESIZE TRUEY: %d BEGY: %d LENY: %d\n", truey, begy, leny);
-      if(wresize(w, leny, truex)){
+      if(resize_window(pr, w, leny, truex)){
         return -1;
       }
       getmaxyx(w, truey, truex);
     }
     if(begy != trueby){
-      if(move_panel(fp, begy, begx)){
+      if(move_tablet_panel(pr, fp, begy, begx)){
         return -1;
       }
     }
   }
-  wresize(w, leny, lenx);
-  bool cliphead = false;
-  bool clipfoot = false;
-  // We pass the coordinates in which the callback may freely write. That's
-  // the full width (minus tablet borders), and the full range of open space
-  // in the direction we're moving. We're not passing *lenghts* to the callback,
-  // but *coordinates* within the window--everywhere save tabletborders.
-  int cby = 0, cbx = 0, cbmaxy = leny, cbmaxx = lenx;
-  --cbmaxy;
-  --cbmaxx;
-  // If we're drawing up, we'll always have a bottom border unless it's masked
-  if(direction < 0 && !(pr->popts.tabletmask & BORDERMASK_BOTTOM)){
-    --cbmaxy;
-  }
-  // If we're drawing down, we'll always have a top border unless it's masked
-  if(direction >= 0 && !(pr->popts.tabletmask & BORDERMASK_TOP)){
-    ++cby;
+  if(getmaxx(w) != lenx){
+    resize_window(pr, w, leny, lenx);
   }
-  // Adjust the x-bounds for side borders, which we always have if unmasked
-  cbmaxx -= !(pr->popts.tabletmask & BORDERMASK_RIGHT);
-  cbx += !(pr->popts.tabletmask & BORDERMASK_LEFT);
-  bool cbdir = direction < 0 ? true : false;
 // fprintf(stderr, "calling! lenx/leny: %d/%d cbx/cby: %d/%d cbmaxx/cbmaxy: %d/%d dir: %d\n",
 //    lenx, leny, cbx, cby, cbmaxx, cbmaxy, direction);
+  // clear before calling, so that a touch during the callback isn't lost
+  atomic_store(&t->dirty, false);
+  uint64_t start = monotonic_ns();
   int ll = t->cbfxn(t, cbx, cby, cbmaxx, cbmaxy, cbdir);
+  pr->stats.callback_ns += monotonic_ns() - start;
+  ++pr->stats.callbacks;
+  t->cblines = ll;
+  t->cbdir = cbdir;
+  t->natural = ll < cbmaxy - cby + 1;
 //fprintf(stderr, "RETURNRETURNRETURN %p %d (%d, %d, %d) DIR %d\n",
 //        t, ll, cby, cbmaxy, leny, direction);
-  if(ll != leny){
-    if(ll == leny - 1){ // only has one border visible (partially off-screen)
-      if(cbdir){
-        ll += !(pr->popts.tabletmask & BORDERMASK_BOTTOM);
-      }else{
-        ll += !(pr->popts.tabletmask & BORDERMASK_TOP);
-      }
-      wresize(w, ll, lenx);
-      if(direction < 0){
-        cliphead = true;
-        move_panel(fp, begy + leny - ll, begx);
-// fprintf(stderr, "MOVEDOWN CLIPPED RESIZED (-1) from %d to %d\n", leny, ll);
-      }else{
-        clipfoot = true;
-// fprintf(stderr, "RESIZED (-1) from %d to %d\n", leny, ll);
-      }
-    }else{ // both borders are visible
-      ll += !(pr->popts.tabletmask & BORDERMASK_BOTTOM) +
-            !(pr->popts.tabletmask & BORDERMASK_TOP);
-// fprintf(stderr, "RESIZING (-2) from %d to %d\n", leny, ll);
-      wresize(w, ll, lenx);
-      if(direction < 0){
-// fprintf(stderr, "MOVEDOWN UNCLIPPED (skip %d)\n", leny - ll);
-        if(move_panel(fp, begy + leny - ll, begx)){
-          return -1;
-        }
-      }
-    }
-    // The focused tablet will have been resized properly above, but it might
-    // be out of position (the focused tablet ought move as little as possible). 
-    // Move it back to the frontier, or the nearest line above if it has grown.
-    if(direction == 0){
-      if(leny - frontiery + 1 < ll){
-//fprintf(stderr, "frontieryIZING ADJ %d %d %d %d NEW %d\n", cbmaxy, leny,
-//         frontiery, ll, frontiery - ll + 1);
-        frontiery = leny - ll + getbegy(panel_window(pr->p));
-      }
-      if(move_panel(fp, frontiery, begx)){
-        return -1;
-      }
+  // the callback has drawn into all the space it might have used. shrink the
+  // window down to what it actually used, and move it into place.
+  int rows, y;
+  bool cliphead, clipfoot;
+  tablet_geometry(pr, ll, frontiery, direction, begy, leny,
+                  &rows, &y, &cliphead, &clipfoot);
+  if(rows != getmaxy(w)){ // a new window was made a row taller than leny
+    resize_window(pr, w, rows, lenx);
+  }
+  if(y != getbegy(w)){
+    if(move_tablet_panel(pr, fp, y, begx)){
+      return -1;
     }
   }
+  t->focusborder = direction == 0;
   draw_borders(w, pr->popts.tabletmask,
                 direction == 0 ? pr->popts.focusedattr : pr->popts.tabletattr,
                 direction == 0 ? pr->popts.focusedpair : pr->popts.tabletpair,
@@ -330,15 +869,28 @@ panelreel_draw_tablet(const panelreel* pr, tablet* t, int frontiery,
   return cliphead || clipfoot;
 }
 
+// draw_tablet(), within a tracepoint span.
+static int
+panelreel_draw_tablet(panelreel* pr, tablet* t, int frontiery,
+                      int direction){
+  TRACE_BEGIN("panelreel_draw_tablet");
+  int ret = draw_tablet(pr, t, frontiery, direction);
+  TRACE_END("panelreel_draw_tablet");
+  return ret;
+}
+
 // draw and size the focused tablet, which must exist (pr->tablets may not be
 // NULL). it can occupy the entire panelreel.
 static int
-draw_focused_tablet(const panelreel* pr){
+draw_focused_tablet(panelreel* pr){
   int pbegy, pbegx, plenx, pleny; // panelreel window coordinates
   window_coordinates(panel_window(pr->p), &pbegy, &pbegx, &pleny, &plenx);
   int fulcrum;
-  if(pr->tablets->p == NULL){
-    if(pr->last_traveled_direction >= 0){
+  // jumps are always placed at the top, and laid out as if we'd moved up to
+  // an offscreen tablet. placing them anywhere else can leave an unfillable
+  // gap above them.
+  if(pr->tablets->p == NULL || pr->last_traveled_direction == 0){
+    if(pr->last_traveled_direction > 0){
       fulcrum = pleny + pbegy - !(pr->popts.bordermask & BORDERMASK_BOTTOM);
     }else{
       fulcrum = pbegy + !(pr->popts.bordermask & BORDERMASK_TOP);
@@ -368,10 +920,11 @@ draw_focused_tablet(const panelreel* pr){
 // move down below the focused tablet, filling up the reel to the bottom.
 // returns the last tablet drawn.
 static tablet*
-draw_following_tablets(const panelreel* pr, const tablet* otherend){
+draw_following_tablets(panelreel* pr, const tablet* otherend){
   int wmaxy, wbegy, wbegx, wlenx, wleny; // working tablet window coordinates
   tablet* working = pr->tablets;
   int frontiery;
+  TRACE_BEGIN("draw_following_tablets");
   // move down past the focused tablet, filling up the reel to the bottom
   do{
     window_coordinates(panel_window(working->p), &wbegy, &wbegx, &wleny, &wlenx);
@@ -387,16 +940,18 @@ draw_following_tablets(const panelreel* pr, const tablet* otherend){
       otherend = otherend->next;
     }
   }while(working->p);
+  TRACE_END("draw_following_tablets");
   return working;
 }
 
 // move up above the focused tablet, filling up the reel to the top.
 // returns the last tablet drawn.
 static tablet*
-draw_previous_tablets(const panelreel* pr, const tablet* otherend){
+draw_previous_tablets(panelreel* pr, const tablet* otherend){
   int wbegy, wbegx, wlenx, wleny; // working tablet window coordinates
   tablet* upworking = pr->tablets;
   int frontiery;
+  TRACE_BEGIN("draw_previous_tablets");
   // modify frontier based off the one we're at
   window_coordinates(panel_window(upworking->p), &wbegy, &wbegx, &wleny, &wlenx);
   frontiery = wbegy - 2;
@@ -416,6 +971,7 @@ draw_previous_tablets(const panelreel* pr, const tablet* otherend){
     }
   }
   // FIXME keep going backwards, hiding those no longer visible
+  TRACE_END("draw_previous_tablets");
   return upworking;
 }
 
@@ -456,12 +1012,12 @@ panelreel_arrange_denormalized(panelreel* pr){
   int wbegy, wbegx, wleny, wlenx;
   window_coordinates(panel_window(pr->p), &wbegy, &wbegx, &wleny, &wlenx);
   int frontiery = wbegy + !(pr->popts.bordermask & BORDERMASK_TOP);
-  if(pr->last_traveled_direction >= 0){
+  if(pr->last_traveled_direction > 0){
     fromline = getbegy(panel_window(pr->tablets->prev->p));
     if(fromline > nowline){ // keep the order we had
       topmost = topmost->next;
     }
-  }else{
+  }else if(pr->last_traveled_direction < 0){ // jumps keep the order we had
     fromline = getbegy(panel_window(pr->tablets->next->p));
     if(fromline < nowline){ // keep the order we had
       topmost = topmost->prev;
@@ -485,6 +1041,21 @@ panelreel_arrange_denormalized(panelreel* pr){
   return 0;
 }
 
+// Release the panels of tablets which the arrangement just completed didn't
+// reach. They've been pushed offscreen, perhaps by a jump or a growing
+// neighbor. The shown list is never much longer than the reel is tall.
+static void
+hide_stale_tablets(panelreel* pr){
+  tablet* t = pr->shown;
+  while(t){
+    tablet* next = t->shownext;
+    if(t->gen != pr->gen){
+      stash_tablet(pr, t);
+    }
+    t = next;
+  }
+}
+
 // Arrange the panels, starting with the focused window, wherever it may be.
 // If necessary, resize it to the full size of the reel--focus has its
 // privileges. We then work in the opposite direction of travel, filling out
@@ -500,40 +1071,164 @@ panelreel_arrange(panelreel* pr){
   if(focused == NULL){
     return 0; // if none are focused, none exist
   }
+  TRACE_BEGIN("panelreel_arrange");
+  uint64_t start = monotonic_ns();
+  ++pr->gen;
+  int ret;
   // FIXME we special-cased this because i'm dumb and couldn't think of a more
   // elegant way to do this. we keep 'all_visible' as boolean state to avoid
   // having to do an o(n) iteration each round, but this is still grotesque, and
   // feels fragile...
   if(pr->all_visible){
-    return panelreel_arrange_denormalized(pr);
-  }
-  draw_focused_tablet(pr);
-  tablet* otherend = focused;
-  if(pr->last_traveled_direction >= 0){
-    otherend = draw_previous_tablets(pr, otherend);
-    otherend = draw_following_tablets(pr, otherend);
-    otherend = draw_previous_tablets(pr, otherend);
+    ret = panelreel_arrange_denormalized(pr);
   }else{
-    otherend = draw_following_tablets(pr, otherend);
-    otherend = draw_previous_tablets(pr, otherend);
-    otherend = draw_following_tablets(pr, otherend);
+    ret = draw_focused_tablet(pr);
+    tablet* otherend = focused;
+    if(pr->last_traveled_direction > 0){
+      otherend = draw_previous_tablets(pr, otherend);
+      otherend = draw_following_tablets(pr, otherend);
+      otherend = draw_previous_tablets(pr, otherend);
+    }else{
+      otherend = draw_following_tablets(pr, otherend);
+      otherend = draw_previous_tablets(pr, otherend);
+      otherend = draw_following_tablets(pr, otherend);
+    }
   }
+  hide_stale_tablets(pr);
 //fprintf(stderr, "DONE ARRANGING\n");
-  return 0;
+  ++pr->stats.arranges;
+  pr->stats.arrange_ns += monotonic_ns() - start;
+  TRACE_END("panelreel_arrange");
+  return ret;
 }
 
-int panelreel_redraw(panelreel* pr){
+static void sched_arm(panelreel_sched* s);
+static int apply_ops(panelreel* pr);
+
+// Lay out and display the reel immediately. This is the only place the
+// terminal is updated. Untouched tablets are reused where possible.
+static int
+panelreel_display(panelreel* pr){
 //fprintf(stderr, "--------> BEGIN REDRAW <--------\n");
   int ret = 0;
   if(draw_panelreel_borders(pr)){
     return -1; // enforces specified dimensional minima
   }
   ret |= panelreel_arrange(pr);
+  pr->resized = 0;
   update_panels();
+  uint64_t start = monotonic_ns();
   ret |= doupdate();
+  pr->stats.doupdate_ns += monotonic_ns() - start;
+  ++pr->stats.frames;
   return ret;
 }
 
+// Called whenever the reel has changed. Within a batch, display is deferred
+// until the outermost panelreel_commit(). With a scheduler attached, it is
+// deferred until the scheduler's next frame.
+static int
+panelreel_render(panelreel* pr){
+  if(pr->batch || pr->sched){
+    pr->deferred = true;
+    if(!pr->batch){
+      sched_arm(pr->sched);
+    }
+    return 0;
+  }
+  return panelreel_display(pr);
+}
+
+// Offscreen tablets will be drawn anew anyway once they're brought onscreen,
+// so only those having panels need be marked.
+int panelreel_redraw(panelreel* pr){
+  apply_ops(pr);
+  tablet* t;
+  for(t = pr->shown ; t ; t = t->shownext){
+    atomic_store(&t->dirty, true);
+  }
+  return panelreel_render(pr);
+}
+
+// Was the tablet drawn (and left visible) by the most recent arrangement?
+static inline bool
+tablet_current(const panelreel* pr, const tablet* t){
+  return t->p && t->gen == pr->gen;
+}
+
+// Take the entire pending stack, moving its tablets onto the touched list.
+// Once a tablet's queued flag is cleared, a touch will push it anew.
+static void
+collect_pending(panelreel* pr){
+  tablet* t = atomic_exchange(&pr->pending, NULL);
+  while(t){
+    tablet* next = t->pendnext;
+    atomic_store(&t->queued, false);
+    if(!t->ontouched){
+      t->ontouched = true;
+      t->touchnext = pr->touched;
+      pr->touched = t;
+    }
+    t = next;
+  }
+}
+
+// Remove a tablet which is being deleted from the pending stack and touched
+// list. It must not be touched concurrently with its deletion.
+static void
+forget_touched(panelreel* pr, tablet* t){
+  collect_pending(pr);
+  if(t->ontouched){
+    tablet** prev = &pr->touched;
+    while(*prev != t){
+      prev = &(*prev)->touchnext;
+    }
+    *prev = t->touchnext;
+    t->ontouched = false;
+  }
+}
+
+int panelreel_drain_touched(panelreel* pr, tablet** out, int max){
+  int n = 0;
+  if(apply_ops(pr)){
+    pr->drained_visible = true; // the next update must lay out the reel
+  }
+  collect_pending(pr);
+  while(n < max && pr->touched){
+    tablet* t = pr->touched;
+    pr->touched = t->touchnext;
+    t->ontouched = false;
+    drop_pad(pr, t);
+    if(tablet_current(pr, t)){
+      pr->drained_visible = true;
+    }
+    out[n++] = t;
+  }
+  return n;
+}
+
+// Touched tablets might change size, so we must lay out anew, but untouched
+// tablets are placed without invoking their callbacks. Those which don't move
+// cost next to nothing.
+int panelreel_update(panelreel* pr){
+  bool visible = apply_ops(pr) || pr->drained_visible;
+  collect_pending(pr);
+  pr->drained_visible = false;
+  while(pr->touched){
+    tablet* t = pr->touched;
+    pr->touched = t->touchnext;
+    t->ontouched = false;
+    drop_pad(pr, t);
+    if(tablet_current(pr, t) && atomic_load(&t->dirty)){
+      visible = true;
+    }
+  }
+  if(!visible){
+    return 0; // nothing, or only offscreen tablets, were touched
+  }
+  return panelreel_render(pr);
+}
+
 static bool
 validate_panelreel_opts(WINDOW* w, const panelreel_options* popts){
   if(w == NULL){
@@ -557,6 +1252,34 @@ validate_panelreel_opts(WINDOW* w, const panelreel_options* popts){
   return true;
 }
 
+// Determine the size and origin of the reel's window, given the offsets
+// within its containing window w.
+static void
+reel_geometry(WINDOW* w, int toff, int roff, int boff, int loff,
+              int* ylen, int* xlen, int* y, int* x){
+  int maxx, maxy, wx, wy;
+  getbegyx(w, wy, wx);
+  getmaxyx(w, maxy, maxx);
+  --maxy;
+  --maxx;
+  *ylen = maxy - boff - toff + 1;
+  if(*ylen < 0){
+    *ylen = maxy - toff;
+    if(*ylen < 0){
+      *ylen = 0; // but this translates to a full-screen window...FIXME
+    }
+  }
+  *xlen = maxx - roff - loff + 1;
+  if(*xlen < 0){
+    *xlen = maxx - loff;
+    if(*xlen < 0){
+      *xlen = 0; // FIXME see above...
+    }
+  }
+  *y = toff + wy;
+  *x = loff + wx;
+}
+
 panelreel* panelreel_create(WINDOW* w, const panelreel_options* popts, int efd){
   panelreel* pr;
 
@@ -569,42 +1292,51 @@ panelreel* panelreel_create(WINDOW* w, const panelreel_options* popts, int efd){
   pr->efd = efd;
   pr->tablets = NULL;
   pr->tabletcount = 0;
+  iseq_init(&pr->seq);
+  pr->shown = NULL;
+  pr->showncount = 0;
   pr->all_visible = true;
+  atomic_init(&pr->pending, NULL);
+  pr->touched = NULL;
+  pr->drained_visible = false;
+  pr->pool = NULL;
+  pr->poolcount = pr->poolalloc = 0;
+  pr->pads = pr->padtail = NULL;
+  pr->owner = pthread_self();
+  pthread_mutex_init(&pr->oplock, NULL);
+  pr->ops = NULL;
+  pr->opstail = &pr->ops;
+  atomic_init(&pr->opsqueued, false);
+  pr->slabs = NULL;
+  pr->freetablets = NULL;
+  memset(&pr->stats, 0, sizeof(pr->stats));
+  atomic_init(&pr->touches, 0);
+  pr->gen = 0;
+  pr->batch = 0;
+  pr->deferred = false;
+  pr->resized = 0;
+  pr->sched = NULL;
   pr->last_traveled_direction = -1; // draw down after the initial tablet
   memcpy(&pr->popts, popts, sizeof(*popts));
-  int maxx, maxy, wx, wy;
-  getbegyx(w, wy, wx);
-  getmaxyx(w, maxy, maxx);
-  --maxy;
-  --maxx;
-  int ylen, xlen;
-  ylen = maxy - popts->boff - popts->toff + 1;
-  if(ylen < 0){
-    ylen = maxy - popts->toff;
-    if(ylen < 0){
-      ylen = 0; // but this translates to a full-screen window...FIXME
-    }
-  }
-  xlen = maxx - popts->roff - popts->loff + 1;
-  if(xlen < 0){
-    xlen = maxx - popts->loff;
-    if(xlen < 0){
-      xlen = 0; // FIXME see above...
-    }
-  }
-  WINDOW* pw = newwin(ylen, xlen, popts->toff + wy, popts->loff + wx);
+  int ylen, xlen, y, x;
+  reel_geometry(w, popts->toff, popts->roff, popts->boff, popts->loff,
+                &ylen, &xlen, &y, &x);
+  WINDOW* pw = newwin(ylen, xlen, y, x);
   if(pw == NULL){
+    pthread_mutex_destroy(&pr->oplock);
     free(pr);
     return NULL;
   }
   if((pr->p = new_panel(pw)) == NULL){
     delwin(pw);
+    pthread_mutex_destroy(&pr->oplock);
     free(pr);
     return NULL;
   }
-  if(panelreel_redraw(pr)){
+  if(panelreel_render(pr)){
     del_panel(pr->p);
     delwin(pw);
+    pthread_mutex_destroy(&pr->oplock);
     free(pr);
     return NULL;
   }
@@ -613,7 +1345,7 @@ panelreel* panelreel_create(WINDOW* w, const panelreel_options* popts, int efd){
 
 // we've just added a new tablet. it need be inserted at the correct place in
 // the reel. this will naturally fall out of things if the panelreel is full; we
-// can just call panelreel_redraw(). otherwise, we need make ourselves at least
+// can just call panelreel_render(). otherwise, we need make ourselves at least
 // minimally visible, to satisfy the preconditions of
 // panelreel_arrange_denormalized(). this function, and approach, is shit.
 static tablet*
@@ -623,7 +1355,6 @@ insert_new_panel(panelreel* pr, tablet* t){
   }
   int wbegy, wbegx, wleny, wlenx; // params of PR
   window_coordinates(panel_window(pr->p), &wbegy, &wbegx, &wleny, &wlenx);
-  WINDOW* w;
   // are we the only tablet?
   int begx, begy, lenx, leny, frontiery;
   if(t->prev == t){
@@ -633,15 +1364,12 @@ insert_new_panel(panelreel* pr, tablet* t){
       return t;
     }
 //fprintf(stderr, "newwin: %d/%d + %d/%d\n", begy, begx, leny, lenx);
-    if((w = newwin(leny, lenx, begy, begx)) == NULL){
-      pr->all_visible = false;
-      return t;
-    }
-    if((t->p = new_panel(w)) == NULL){
-      delwin(w);
+    PANEL* p = acquire_panel(pr, leny, lenx, begy, begx);
+    if(p == NULL){
       pr->all_visible = false;
       return t;
     }
+    show_tablet(pr, t, p);
 //fprintf(stderr, "created first tablet!\n");
     return t;
   }
@@ -654,37 +1382,45 @@ insert_new_panel(panelreel* pr, tablet* t){
     pr->all_visible = false;
     return t;
   }
-  if((w = newwin(2, lenx, begy, begx)) == NULL){
-    pr->all_visible = false;
-    return t;
-  }
-  if((t->p = new_panel(w)) == NULL){
-    delwin(w);
+  PANEL* p = acquire_panel(pr, 2, lenx, begy, begx);
+  if(p == NULL){
     pr->all_visible = false;
     return t;
   }
+  show_tablet(pr, t, p);
   // FIXME push the other ones down by 4
   return t;
 }
 
-tablet* panelreel_add(panelreel* pr, tablet* after, tablet *before,
-                      tabletcb cbfxn, void* opaque){
-  tablet* t;
-  if(after && before){
-    if(after->prev != before || before->next != after){
-      return NULL;
-    }
-  }else if(!after && !before){
+// Place an initialized tablet on the reel, and give it a panel if there's
+// room. The reel is not rendered.
+static void
+link_tablet(panelreel* pr, tablet* t, tablet* after, tablet* before){
+  // new tablets are placed relative to their neighbors, which must thus be
+  // laid out, even if display is being deferred. this only arises while every
+  // tablet is onscreen (i.e. few exist).
+  if(pr->deferred && pr->all_visible){
+    panelreel_arrange(pr);
+  }
+  if(!after && !before){
     // This way, without user interaction or any specification, new tablets are
     // inserted at the "end" relative to the focus. The first one to be added
     // gets and keeps the focus. New ones will go on the bottom, until we run
     // out of space. New tablets are then created off-screen.
     before = pr->tablets;
   }
-  if((t = malloc(sizeof(*t))) == NULL){
-    return NULL;
-  }
 //fprintf(stderr, "--------->NEW TABLET %p\n", t);
+  // the reel is circular, so being placed before the first tablet is the same
+  // as being placed after the last one.
+  size_t idx = 0;
+  if(after){
+    idx = iseq_index(&after->seq) + 1;
+  }else if(before){
+    if((idx = iseq_index(&before->seq)) == 0){
+      idx = iseq_count(&pr->seq);
+    }
+  }
+  iseq_insert(&pr->seq, &t->seq, idx);
   if(after){
     t->next = after->next;
     after->next = t;
@@ -699,25 +1435,254 @@ tablet* panelreel_add(panelreel* pr, tablet* after, tablet *before,
     t->prev = t->next = t;
     pr->tablets = t;
   }
-  t->cbfxn = cbfxn;
-  t->curry = opaque;
   ++pr->tabletcount;
+  t->linked = true;
   t->p = NULL;
   // if we have room, it needs become visible immediately, in the proper place,
   // lest we invalidate the preconditions of panelreel_arrange_denormalized().
   insert_new_panel(pr, t);
-  panelreel_redraw(pr); // don't return failure; tablet was still created...
+}
+
+// Allocate a tablet, not yet on the reel. Safe to call from any thread.
+static tablet*
+new_tablet(panelreel* pr, tabletcb cbfxn, void* opaque){
+  tablet* t = alloc_tablet(pr);
+  if(t == NULL){
+    return NULL;
+  }
+  t->cbfxn = cbfxn;
+  t->measurecb = NULL;
+  t->measuredcols = -1;
+  t->curry = opaque;
+  atomic_init(&t->dirty, true);
+  atomic_init(&t->queued, false);
+  t->ontouched = false;
+  t->natural = false;
+  t->gen = 0;
+  t->op = TABLET_OP_NONE;
+  t->p = NULL;
+  t->pad = NULL;
   return t;
 }
 
-int panelreel_del_focused(struct panelreel* pr){
-  return panelreel_del(pr, pr->tablets);
+static inline bool
+owning_thread(const panelreel* pr){
+  return pthread_equal(pthread_self(), pr->owner);
 }
 
-int panelreel_del(struct panelreel* pr, struct tablet* t){
-  if(pr == NULL || t == NULL){
+// Append t to the op queue, which must be locked. Returns true if the queue
+// was empty, in which case the owner ought be woken.
+static bool
+enqueue_op(panelreel* pr, tablet* t, unsigned char op){
+  bool wake = pr->ops == NULL;
+  t->op = op;
+  t->opnext = NULL;
+  *pr->opstail = t;
+  pr->opstail = &t->opnext;
+  atomic_store(&pr->opsqueued, true);
+  return wake;
+}
+
+static int
+wake_owner(const panelreel* pr){
+  if(pr->efd >= 0){
+    uint64_t val = 1;
+    if(write(pr->efd, &val, sizeof(val)) != sizeof(val)){
+      fprintf(stderr, "Error writing to eventfd %d (%s)\n",
+              pr->efd, strerror(errno));
+      return -1;
+    }
+  }
+  return 0;
+}
+
+tablet* panelreel_add(panelreel* pr, tablet* after, tablet *before,
+                      tabletcb cbfxn, void* opaque){
+  tablet* t;
+  if(!owning_thread(pr)){
+    if((t = new_tablet(pr, cbfxn, opaque)) == NULL){
+      return NULL;
+    }
+    t->opafter = after;
+    t->opbefore = before;
+    pthread_mutex_lock(&pr->oplock);
+    bool wake = enqueue_op(pr, t, TABLET_OP_ADD);
+    pthread_mutex_unlock(&pr->oplock);
+    if(wake){
+      wake_owner(pr); // don't return failure; tablet was still queued...
+    }
+    return t;
+  }
+  apply_ops(pr); // neighbors might yet be queued
+  if(after && before){
+    if(after->prev != before || before->next != after){
+      return NULL;
+    }
+  }
+  if((t = new_tablet(pr, cbfxn, opaque)) == NULL){
+    return NULL;
+  }
+  link_tablet(pr, t, after, before);
+  panelreel_render(pr); // don't return failure; tablet was still created...
+  return t;
+}
+
+int panelreel_add_many(panelreel* pr, tablet* after, tablet* before,
+                       tabletcb cbfxn, void* const* opaques, int count,
+                       tablet** tablets){
+  int added = 0;
+  bool owner = owning_thread(pr);
+  if(owner){
+    panelreel_begin_batch(pr);
+  }
+  while(added < count){
+    tablet* t = panelreel_add(pr, after, before, cbfxn, opaques[added]);
+    if(t == NULL){
+      break;
+    }
+    if(tablets){
+      tablets[added] = t;
+    }
+    ++added;
+    // later tablets follow this one. when placing before some tablet (or the
+    // focus, by default), that's already the case.
+    if(after){
+      after = t;
+      before = NULL;
+    }
+  }
+  if(owner){
+    panelreel_commit(pr);
+  }
+  return added ? added : -1;
+}
+
+int panelreel_begin_batch(panelreel* pr){
+  ++pr->batch;
+  return 0;
+}
+
+int panelreel_commit(panelreel* pr){
+  if(pr->batch == 0){
     return -1;
   }
+  if(--pr->batch || !pr->deferred){
+    return 0;
+  }
+  pr->deferred = false;
+  return panelreel_render(pr);
+}
+
+// Arm the timer for the next frame deadline, unless it's already armed. A
+// deadline in the past expires immediately.
+static void
+sched_arm(panelreel_sched* s){
+  if(s->armed){
+    return;
+  }
+  uint64_t deadline = s->lastframe + s->interval;
+  if(s->pr && s->pr->resized && deadline < s->pr->resized + RESIZE_QUIET_NS){
+    deadline = s->pr->resized + RESIZE_QUIET_NS;
+  }
+  struct itimerspec its = {
+    .it_interval = { .tv_sec = 0, .tv_nsec = 0, },
+    .it_value = {
+      .tv_sec = deadline / NANOSECS_IN_SEC,
+      .tv_nsec = deadline % NANOSECS_IN_SEC,
+    },
+  };
+  if(its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0){
+    its.it_value.tv_nsec = 1; // zero would disarm the timer
+  }
+  if(timerfd_settime(s->fd, TFD_TIMER_ABSTIME, &its, NULL)){
+    fprintf(stderr, "Error arming timerfd %d (%s)\n", s->fd, strerror(errno));
+    return;
+  }
+  s->armed = true;
+}
+
+panelreel_sched* panelreel_sched_create(panelreel* pr, unsigned maxfps){
+  if(pr->sched){
+    return NULL;
+  }
+  panelreel_sched* s = malloc(sizeof(*s));
+  if(s == NULL){
+    return NULL;
+  }
+  if((s->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0){
+    fprintf(stderr, "Error creating timerfd (%s)\n", strerror(errno));
+    free(s);
+    return NULL;
+  }
+  s->pr = pr;
+  s->interval = maxfps ? NANOSECS_IN_SEC / maxfps : 0;
+  s->lastframe = 0;
+  s->armed = false;
+  pr->sched = s;
+  if(pr->deferred && !pr->batch){
+    sched_arm(s);
+  }
+  return s;
+}
+
+int panelreel_sched_fd(const panelreel_sched* s){
+  return s->fd;
+}
+
+int panelreel_sched_run(panelreel_sched* s){
+  uint64_t expirations;
+  if(read(s->fd, &expirations, sizeof(expirations)) < 0){
+    if(errno != EAGAIN){
+      fprintf(stderr, "Error reading timerfd %d (%s)\n", s->fd, strerror(errno));
+      return -1;
+    }
+    if(s->armed){
+      return 0; // spurious wakeup; the deadline is yet to come
+    }
+  }
+  s->armed = false;
+  panelreel* pr = s->pr;
+  if(pr && apply_ops(pr)){
+    pr->deferred = true;
+  }
+  // a batch will arm us anew upon its commit
+  if(pr == NULL || !pr->deferred || pr->batch){
+    return 0;
+  }
+  // a resize storm is laid out once it has subsided
+  if(pr->resized && monotonic_ns() < pr->resized + RESIZE_QUIET_NS){
+    sched_arm(s);
+    return 0;
+  }
+  pr->deferred = false;
+  s->lastframe = monotonic_ns();
+  return panelreel_display(pr);
+}
+
+int panelreel_sched_destroy(panelreel_sched* s){
+  int ret = 0;
+  if(s){
+    panelreel* pr = s->pr;
+    if(pr){
+      pr->sched = NULL;
+      if(pr->deferred && !pr->batch){ // don't lose the pending frame
+        pr->deferred = false;
+        ret = panelreel_display(pr);
+      }
+    }
+    close(s->fd);
+    free(s);
+  }
+  return ret;
+}
+
+int panelreel_del_focused(struct panelreel* pr){
+  return panelreel_del(pr, pr->tablets);
+}
+
+// Remove a tablet from the reel, without rendering it.
+static void
+unlink_tablet(panelreel* pr, tablet* t){
   t->prev->next = t->next;
   if(pr->tablets == t){
     if((pr->tablets = t->next) == t){
@@ -725,28 +1690,152 @@ int panelreel_del(struct panelreel* pr, struct tablet* t){
     }
   }
   t->next->prev = t->prev;
-  if(t->p){
-    WINDOW* w = panel_window(t->p);
-    del_panel(t->p);
-    delwin(w);
-  }
-  free(t);
+  iseq_remove(&pr->seq, &t->seq);
+  forget_touched(pr, t);
+  hide_tablet(pr, t);
+  drop_pad(pr, t);
+  free_tablet(pr, t);
   --pr->tabletcount;
-  update_panels();
-  panelreel_redraw(pr);
+}
+
+int panelreel_del(struct panelreel* pr, struct tablet* t){
+  if(pr == NULL || t == NULL){
+    return -1;
+  }
+  bool owner = owning_thread(pr);
+  bool wake = false;
+  pthread_mutex_lock(&pr->oplock);
+  unsigned char op = t->op;
+  if(op == TABLET_OP_ADD){
+    t->op = TABLET_OP_CANCEL; // it's already on the queue
+  }else if(op == TABLET_OP_NONE && !owner){
+    wake = enqueue_op(pr, t, TABLET_OP_DEL);
+  }
+  pthread_mutex_unlock(&pr->oplock);
+  if(op == TABLET_OP_DEL || op == TABLET_OP_CANCEL){
+    return -1; // already being deleted
+  }
+  if(op == TABLET_OP_ADD || !owner){
+    return wake ? wake_owner(pr) : 0;
+  }
+  unlink_tablet(pr, t);
+  panelreel_render(pr);
   return 0;
 }
 
+// Apply the structural changes queued by other threads, in the order they
+// were made, without rendering the reel. Returns the number applied. The
+// queue is detached under the lock, and applied outside of it. Each entry
+// keeps its op until it's reached, so that a deletion of a tablet whose add is
+// still pending marks it cancelled rather than queueing it anew (which would
+// rewrite its opnext while we walk the batch). Once its op is cleared, the
+// tablet might be queued again, so opnext is read before the lock is dropped.
+static int
+apply_ops(panelreel* pr){
+  if(!atomic_load(&pr->opsqueued)){
+    return 0;
+  }
+  pthread_mutex_lock(&pr->oplock);
+  tablet* t = pr->ops;
+  pr->ops = NULL;
+  pr->opstail = &pr->ops;
+  atomic_store(&pr->opsqueued, false);
+  pthread_mutex_unlock(&pr->oplock);
+  // the caller renders once we're done, so apply them as a batch would,
+  // laying out neighbors before placing new tablets relative to them
+  bool deferred = pr->deferred;
+  pr->deferred = true;
+  int applied = 0;
+  while(t){
+    pthread_mutex_lock(&pr->oplock);
+    unsigned char op = t->op;
+    t->op = TABLET_OP_NONE;
+    tablet* next = t->opnext;
+    pthread_mutex_unlock(&pr->oplock);
+    if(op == TABLET_OP_ADD){
+      tablet* after = t->opafter;
+      tablet* before = t->opbefore;
+      // neighbors might have been deleted since the add was queued, even
+      // earlier in this very batch
+      if(after && !after->linked){
+        after = NULL;
+      }
+      if(before && !before->linked){
+        before = NULL;
+      }
+      if(after && before){
+        if(after->prev != before || before->next != after){
+          after = before = NULL; // no longer adjacent; add it anywhere
+        }
+      }
+      link_tablet(pr, t, after, before);
+    }else if(op == TABLET_OP_DEL){
+      unlink_tablet(pr, t);
+    }else{ // TABLET_OP_CANCEL; it was never on the reel
+      forget_touched(pr, t);
+      free_tablet(pr, t);
+    }
+    ++applied;
+    t = next;
+  }
+  pr->deferred = deferred;
+  return applied;
+}
+
+// Every tablet lives in some slab, so only their panels need be released,
+// and the slabs freed. This takes time linear in the number of slabs, and
+// doesn't lay out the reel. Tablets must not be touched concurrently. Queued
+// adds are discarded along with everything else.
+static void
+free_tablets(panelreel* pr){
+  while(pr->shown){
+    hide_tablet(pr, pr->shown);
+  }
+  while(pr->pads){
+    drop_pad(pr, pr->pads);
+  }
+  atomic_store(&pr->pending, NULL);
+  pr->touched = NULL;
+  pr->drained_visible = false;
+  pthread_mutex_lock(&pr->oplock);
+  pr->ops = NULL;
+  pr->opstail = &pr->ops;
+  atomic_store(&pr->opsqueued, false);
+  while(pr->slabs){
+    tabletslab* slab = pr->slabs;
+    pr->slabs = slab->next;
+    free(slab);
+  }
+  pr->freetablets = NULL;
+  pthread_mutex_unlock(&pr->oplock);
+  iseq_init(&pr->seq);
+  pr->tablets = NULL;
+  pr->tabletcount = 0;
+  pr->all_visible = true;
+  pr->last_traveled_direction = -1;
+}
+
+int panelreel_clear(panelreel* pr){
+  free_tablets(pr);
+  return panelreel_render(pr);
+}
+
 int panelreel_destroy(panelreel* preel){
   int ret = 0;
   if(preel){
-    tablet* t = preel->tablets;
-    while(t){
-      t->prev->next = NULL;
-      tablet* tmp = t->next;
-      panelreel_del(preel, t);
-      t = tmp;
+    if(preel->sched){
+      preel->sched->pr = NULL;
     }
+    free_tablets(preel);
+    while(preel->poolcount){
+      destroy_panel(preel, preel->pool[--preel->poolcount]);
+    }
+    free(preel->pool);
+    WINDOW* w = panel_window(preel->p);
+    del_panel(preel->p);
+    delwin(w);
+    update_panels();
+    pthread_mutex_destroy(&preel->oplock);
     free(preel);
   }
   return ret;
@@ -756,10 +1845,21 @@ int panelreel_tabletcount(const panelreel* preel){
   return preel->tabletcount;
 }
 
+// Safe to call from any thread. Only the first touch of a tablet since it was
+// last collected pushes it, and only a push onto an empty stack writes efd, so
+// there's at most one wakeup per panelreel_update().
 int panelreel_touch(panelreel* pr, tablet* t){
-  (void)t; // FIXME make these more granular eventually
   int ret = 0;
-  if(pr->efd >= 0){
+  atomic_fetch_add_explicit(&pr->touches, 1, memory_order_relaxed);
+  atomic_store(&t->dirty, true);
+  if(atomic_exchange(&t->queued, true)){
+    return 0; // already pending
+  }
+  tablet* head = atomic_load(&pr->pending);
+  do{
+    t->pendnext = head;
+  }while(!atomic_compare_exchange_weak(&pr->pending, &head, t));
+  if(head == NULL && pr->efd >= 0){
     uint64_t val = 1;
     if(write(pr->efd, &val, sizeof(val)) != sizeof(val)){
       fprintf(stderr, "Error writing to eventfd %d (%s)\n",
@@ -784,10 +1884,45 @@ move_tablet(PANEL* p, int deltax, int deltay){
   return 0;
 }
 
+// The slab counters are updated under oplock by whichever thread adds.
+void panelreel_get_stats(const panelreel* pr, panelreel_stats* stats){
+  pthread_mutex_t* oplock = (pthread_mutex_t*)&pr->oplock;
+  pthread_mutex_lock(oplock);
+  *stats = pr->stats;
+  pthread_mutex_unlock(oplock);
+  stats->touches = atomic_load_explicit(&pr->touches, memory_order_relaxed);
+}
+
+void panelreel_reset_stats(panelreel* pr){
+  pthread_mutex_lock(&pr->oplock);
+  // the byte counts are gauges, not accumulations
+  unsigned long window_bytes = pr->stats.window_bytes;
+  unsigned long pad_bytes = pr->stats.pad_bytes;
+  memset(&pr->stats, 0, sizeof(pr->stats));
+  pr->stats.window_bytes = window_bytes;
+  pr->stats.pad_bytes = pad_bytes;
+  pthread_mutex_unlock(&pr->oplock);
+  atomic_store_explicit(&pr->touches, 0, memory_order_relaxed);
+}
+
 tablet* panelreel_focused(panelreel* pr){
   return pr->tablets;
 }
 
+int panelreel_focused_index(const panelreel* pr){
+  if(pr->tablets == NULL){
+    return -1;
+  }
+  return iseq_index(&pr->tablets->seq);
+}
+
+tablet* panelreel_tablet_at(panelreel* pr, int idx){
+  if(idx < 0){
+    return NULL;
+  }
+  return tablet_of(iseq_at(&pr->seq, idx));
+}
+
 int panelreel_move(panelreel* preel, int x, int y){
   WINDOW* w = panel_window(preel->p);
   int oldx, oldy;
@@ -796,31 +1931,49 @@ int panelreel_move(panelreel* preel, int x, int y){
   const int deltay = y - oldy;
   if(move_tablet(preel->p, deltax, deltay)){
     move_panel(preel->p, oldy, oldx);
-    panelreel_redraw(preel);
+    panelreel_render(preel);
     return -1;
   }
-  if(preel->tablets){
-    tablet* t = preel->tablets;
-    do{
-      if(t->p == NULL){
-        break;
-      }
-      move_tablet(t->p, deltax, deltay);
-    }while((t = t->prev) != preel->tablets);
-    if(t != preel->tablets){ // don't repeat if we covered all tablets
-      for(t = preel->tablets->next ; t != preel->tablets ; t = t->next){
-        if(t->p == NULL){
-          break;
-        }
-        move_tablet(t->p, deltax, deltay);
-      }
-    }
+  tablet* t;
+  for(t = preel->shown ; t ; t = t->shownext){
+    ++preel->stats.moves;
+    move_tablet(t->p, deltax, deltay);
   }
-  update_panels();
-  panelreel_redraw(preel);
+  panelreel_render(preel);
   return 0;
 }
 
+// The window is resized in place, and the reel laid out as after any other
+// change: tablets keep their panels, and only those whose width changed have
+// their callbacks invoked. The focused tablet stays where it was, if it fits.
+int panelreel_resize(panelreel* pr, WINDOW* w){
+  WINDOW* rw = panel_window(pr->p);
+  // the reel keeps its place within w, whether or not it has been moved
+  int toff = getbegy(rw) - getbegy(w);
+  int loff = getbegx(rw) - getbegx(w);
+  int ylen, xlen, y, x;
+  reel_geometry(w, toff, pr->popts.roff, pr->popts.boff, loff,
+                &ylen, &xlen, &y, &x);
+  if(ylen == getmaxy(rw) && xlen == getmaxx(rw) &&
+     y == getbegy(rw) && x == getbegx(rw)){
+    return 0;
+  }
+  if(wresize(rw, ylen, xlen) != OK){
+    return -1;
+  }
+  if((y != getbegy(rw) || x != getbegx(rw)) && move_panel(pr->p, y, x) != OK){
+    return -1;
+  }
+  werase(rw); // the old borders might now lie within the reel
+  ++pr->stats.reel_resizes;
+  pr->resized = monotonic_ns();
+  if(pr->sched){
+    pr->sched->armed = false; // push the deadline back past this resize
+  }
+  apply_ops(pr);
+  return panelreel_render(pr);
+}
+
 tablet* panelreel_next(panelreel* pr){
   if(pr->tablets){
     pr->tablets = pr->tablets->next;
@@ -828,7 +1981,7 @@ tablet* panelreel_next(panelreel* pr){
 //        pr->tablets->prev, pr->tablets);
     pr->last_traveled_direction = 1;
   }
-  panelreel_redraw(pr);
+  panelreel_render(pr);
   return pr->tablets;
 }
 
@@ -839,10 +1992,86 @@ tablet* panelreel_prev(panelreel* pr){
 //        pr->tablets->next, pr->tablets);
     pr->last_traveled_direction = -1;
   }
-  panelreel_redraw(pr);
+  panelreel_render(pr);
   return pr->tablets;
 }
 
+// Moving to a neighbor is done as panelreel_next() or panelreel_prev() would,
+// so that the reel scrolls the same way. Anything further is a jump.
+tablet* panelreel_focus(panelreel* pr, tablet* t){
+  if(t == NULL || t == pr->tablets){
+    return t;
+  }
+  if(t == pr->tablets->next){
+    return panelreel_next(pr);
+  }
+  if(t == pr->tablets->prev){
+    return panelreel_prev(pr);
+  }
+  pr->tablets = t;
+  pr->last_traveled_direction = 0;
+  panelreel_render(pr);
+  return t;
+}
+
+tablet* panelreel_focus_index(panelreel* pr, int idx){
+  return panelreel_focus(pr, panelreel_tablet_at(pr, idx));
+}
+
+// Starting from the focus, walk in the specified direction so long as the
+// tablets are onscreen and proceeding in that direction (a reel might wrap
+// around onscreen), returning the last one reached.
+static tablet*
+farthest_visible(const panelreel* pr, int direction){
+  tablet* t = pr->tablets;
+  while(true){
+    tablet* n = direction > 0 ? t->next : t->prev;
+    if(n == pr->tablets || !tablet_current(pr, n)){
+      break;
+    }
+    int y = getbegy(panel_window(t->p));
+    int ny = getbegy(panel_window(n->p));
+    if(direction > 0 ? ny <= y : ny >= y){
+      break;
+    }
+    t = n;
+  }
+  return t;
+}
+
+// Paging first moves the focus to the far edge of the screen. Once there, it
+// moves a screenful further (less one tablet, so that there's continuity),
+// and the new focus is brought onscreen as if we'd stepped to it.
+static tablet*
+panelreel_page(panelreel* pr, int direction){
+  if(pr->tablets == NULL){
+    return NULL;
+  }
+  tablet* t = farthest_visible(pr, direction);
+  if(t == pr->tablets){
+    // if everything's onscreen, there's no further page; just step
+    int steps = 1;
+    if(!pr->all_visible && pr->showncount > 2){
+      steps = pr->showncount - 1;
+    }
+    while(steps--){
+      t = direction > 0 ? t->next : t->prev;
+    }
+  }
+  pr->tablets = t;
+  pr->last_traveled_direction = direction;
+  panelreel_render(pr);
+  return t;
+}
+
+tablet* panelreel_page_down(panelreel* pr){
+  return panelreel_page(pr, 1);
+}
+
+tablet* panelreel_page_up(panelreel* pr){
+  return panelreel_page(pr, -1);
+}
+
 // Used for unit tests. Step through the panelreel and verify that everything
 // seems to be where it ought be, considering its parent WINDOW.
 int panelreel_validate(WINDOW* parent, panelreel* pr){
@@ -987,6 +2216,12 @@ int panelreel_validate(WINDOW* parent, panelreel* pr){
   return 0;
 }
 
+int panelreel_set_measurecb(panelreel* pr, tablet* t, tabletmeasurecb cb){
+  t->measurecb = cb;
+  t->measuredcols = -1;
+  return panelreel_touch(pr, t);
+}
+
 void* tablet_userptr(tablet* t){
   return t->curry;
 }
@@ -0,0 +1,101 @@
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "outcurses.h"
+#include "trace.h"
+
+#ifdef OUTCURSES_TRACE
+// The most recent TRACE_EVENTS events are retained in a ring. Recording an
+// event is a fetch-and-add plus a few stores; nothing is formatted until the
+// ring is dumped. An event's seq is published last, and is one more than its
+// position in the stream, so a reader can tell a complete event from one
+// which is still being (or has since been) overwritten.
+#define TRACE_EVENTS (1u << 16)
+
+typedef struct traceent {
+  atomic_ulong seq;   // 0 if never written
+  const char* name;
+  uint64_t ns;
+  pid_t tid;
+  char phase;
+} traceent;
+
+static traceent ring[TRACE_EVENTS];
+static atomic_ulong trace_next;  // position of the next event
+static atomic_ulong trace_floor; // events before this were cleared
+
+static _Thread_local pid_t trace_tid;
+
+void trace_event(const char* name, char phase){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  if(trace_tid == 0){
+    trace_tid = syscall(SYS_gettid);
+  }
+  unsigned long pos = atomic_fetch_add_explicit(&trace_next, 1, memory_order_relaxed);
+  traceent* e = &ring[pos % TRACE_EVENTS];
+  atomic_store_explicit(&e->seq, 0, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  e->name = name;
+  e->ns = ts.tv_sec * 1000000000ull + ts.tv_nsec;
+  e->tid = trace_tid;
+  e->phase = phase;
+  atomic_store_explicit(&e->seq, pos + 1, memory_order_release);
+}
+
+int outcurses_trace_dump(FILE* fp){
+  unsigned long end = atomic_load(&trace_next);
+  unsigned long pos = atomic_load(&trace_floor);
+  if(end - pos > TRACE_EVENTS){
+    pos = end - TRACE_EVENTS;
+  }
+  int pid = getpid();
+  int events = 0;
+  if(fprintf(fp, "{\"traceEvents\":[") < 0){
+    return -1;
+  }
+  for( ; pos < end ; ++pos){
+    traceent* e = &ring[pos % TRACE_EVENTS];
+    if(atomic_load_explicit(&e->seq, memory_order_acquire) != pos + 1){
+      continue; // still being written, or already lapped
+    }
+    traceent copy;
+    copy.name = e->name;
+    copy.ns = e->ns;
+    copy.tid = e->tid;
+    copy.phase = e->phase;
+    atomic_thread_fence(memory_order_acquire);
+    if(atomic_load_explicit(&e->seq, memory_order_relaxed) != pos + 1){
+      continue; // overwritten while we copied it
+    }
+    // timestamps are in microseconds
+    if(fprintf(fp, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu.%03llu,"
+               "\"pid\":%d,\"tid\":%d}", events ? "," : "", copy.name,
+               copy.phase, (unsigned long long)(copy.ns / 1000),
+               (unsigned long long)(copy.ns % 1000), pid, copy.tid) < 0){
+      return -1;
+    }
+    ++events;
+  }
+  if(fprintf(fp, "\n],\"displayTimeUnit\":\"ns\"}\n") < 0){
+    return -1;
+  }
+  return events;
+}
+
+void outcurses_trace_clear(void){
+  atomic_store(&trace_floor, atomic_load(&trace_next));
+}
+#else
+int outcurses_trace_dump(FILE* fp){
+  if(fprintf(fp, "{\"traceEvents\":[],\"displayTimeUnit\":\"ns\"}\n") < 0){
+    return -1;
+  }
+  return 0;
+}
+
+void outcurses_trace_clear(void){
+}
+#endif
@@ -0,0 +1,90 @@
+#include "main.h"
+#include <cstdlib>
+
+class ColorPairTest : public :: testing::Test {
+  void SetUp() override {
+    if(getenv("TERM") == nullptr){
+      GTEST_SKIP();
+    }
+  }
+
+  void TearDown() override {
+    endwin();
+  }
+};
+
+// The first pairs are set up eagerly as the palette atop the default
+// background, and outcurses_pair() ought hand them back directly.
+TEST_F(ColorPairTest, FixedPairs) {
+  ASSERT_NE(nullptr, outcurses_init(true));
+  EXPECT_EQ(0, outcurses_pair(-1, -1));
+  EXPECT_EQ(COLOR_GREEN, outcurses_pair(COLOR_GREEN, -1));
+  EXPECT_EQ(0, outcurses_pair_release(COLOR_GREEN));
+  int fg, bg;
+  ASSERT_EQ(OK, extended_pair_content(COLOR_GREEN, &fg, &bg));
+  EXPECT_EQ(COLOR_GREEN, fg);
+  EXPECT_EQ(-1, bg);
+  ASSERT_EQ(0, outcurses_stop(true));
+}
+
+TEST_F(ColorPairTest, InvalidColorsRejected) {
+  ASSERT_NE(nullptr, outcurses_init(true));
+  EXPECT_EQ(-1, outcurses_pair(COLORS, -1));
+  EXPECT_EQ(-1, outcurses_pair(-1, -2));
+  ASSERT_EQ(0, outcurses_stop(true));
+}
+
+// The same combination ought be shared, and refcounted.
+TEST_F(ColorPairTest, PairsAreShared) {
+  ASSERT_NE(nullptr, outcurses_init(true));
+  int p1 = outcurses_pair(COLOR_RED, COLOR_BLUE);
+  ASSERT_LT(0, p1);
+  int p2 = outcurses_pair(COLOR_RED, COLOR_BLUE);
+  EXPECT_EQ(p1, p2);
+  int p3 = outcurses_pair(COLOR_BLUE, COLOR_RED);
+  ASSERT_LT(0, p3);
+  EXPECT_NE(p1, p3);
+  int fg, bg;
+  ASSERT_EQ(OK, extended_pair_content(p1, &fg, &bg));
+  EXPECT_EQ(COLOR_RED, fg);
+  EXPECT_EQ(COLOR_BLUE, bg);
+  EXPECT_EQ(0, outcurses_pair_release(p1));
+  EXPECT_EQ(0, outcurses_pair_release(p2));
+  EXPECT_EQ(-1, outcurses_pair_release(p1));
+  EXPECT_EQ(0, outcurses_pair_release(p3));
+  ASSERT_EQ(0, outcurses_stop(true));
+}
+
+// Once every pair is referenced, we ought fail. Releasing one ought allow it
+// to be recycled for a new combination.
+TEST_F(ColorPairTest, ExhaustionRecycles) {
+  ASSERT_NE(nullptr, outcurses_init(true));
+  int last = -1;
+  int fg = 0, bg = 0;
+  for(bg = 0 ; bg < COLORS && last >= -1 ; ++bg){
+    for(fg = 0 ; fg < COLORS ; ++fg){
+      int p = outcurses_pair(fg, bg);
+      if(p < 0){
+        last = -2;
+        break;
+      }
+      last = p;
+    }
+  }
+  if(last != -2){
+    ASSERT_EQ(0, outcurses_stop(true));
+    GTEST_SKIP(); // every combination fit; nothing to recycle
+  }
+  --bg; // fg/bg is the combination which failed
+  EXPECT_EQ(-1, outcurses_pair(fg, bg));
+  int victim = outcurses_pair(0, 0);
+  ASSERT_LT(0, victim);
+  EXPECT_EQ(0, outcurses_pair_release(victim));
+  EXPECT_EQ(0, outcurses_pair_release(victim));
+  EXPECT_EQ(victim, outcurses_pair(fg, bg));
+  int cfg, cbg;
+  ASSERT_EQ(OK, extended_pair_content(victim, &cfg, &cbg));
+  EXPECT_EQ(fg, cfg);
+  EXPECT_EQ(bg, cbg);
+  ASSERT_EQ(0, outcurses_stop(true));
+}
@@ -1,6 +1,23 @@
 #include "main.h"
 #include <cstdlib>
 #include <iostream>
+#include <sys/poll.h>
+
+// Every step is either written, dropped, or missed, and each frame lands in
+// one latency bucket.
+static void
+check_fade_stats(const outcurses_fade_stats& stats){
+  EXPECT_LT(0, stats.steps);
+  EXPECT_LT(0, stats.frames);
+  EXPECT_EQ(stats.steps + 1, stats.frames + stats.dropped + stats.missed);
+  EXPECT_LE(stats.late_wakeups, stats.missed);
+  unsigned framecount = 0;
+  for(auto l : stats.latency){
+    framecount += l;
+  }
+  EXPECT_EQ(stats.frames, framecount);
+  EXPECT_LE(stats.frames, stats.colors);
+}
 
 void fade_setup(WINDOW* w) {
   EXPECT_EQ(OK, wborder(w, 0, 0, 0, 0, 0, 0, 0, 0));
@@ -54,3 +71,166 @@ TEST(OutcursesFade, FadeIn) {
   ASSERT_EQ(0, outcurses_stop(true));
   delete[] palette;
 }
+
+TEST(OutcursesFade, FadeTo) {
+  if(getenv("TERM") == nullptr){
+	  GTEST_SKIP();
+  }
+  ASSERT_NE(nullptr, outcurses_init(true));
+  if(!can_change_color()){
+    outcurses_stop(true);
+    GTEST_SKIP();
+  }
+  outcurses_rgb* orig = new outcurses_rgb[COLORS];
+  outcurses_rgb* to = new outcurses_rgb[COLORS];
+  outcurses_rgb* cur = new outcurses_rgb[COLORS];
+  ASSERT_EQ(0, retrieve_palette(COLORS, orig, nullptr, false));
+  fade_setup(stdscr);
+  for(int i = 0 ; i < COLORS ; ++i){
+    to[i] = orig[i];
+    if(i % 2){ // leave the even colors untouched
+      to[i].r = 1000 - to[i].r;
+      to[i].b /= 2;
+    }
+  }
+  ASSERT_EQ(0, fadeto(stdscr, COLORS, nullptr, to, 250));
+  outcurses_fade_stats stats;
+  ASSERT_EQ(0, outcurses_last_fade_stats(&stats));
+  check_fade_stats(stats);
+  EXPECT_LT(-250000000l, stats.overrun_ns);
+  ASSERT_EQ(0, retrieve_palette(COLORS, cur, nullptr, false));
+  for(int i = 0 ; i < COLORS ; ++i){
+    EXPECT_EQ(to[i].r, cur[i].r);
+    EXPECT_EQ(to[i].g, cur[i].g);
+    EXPECT_EQ(to[i].b, cur[i].b);
+  }
+  // a fade of no length goes straight to the destination
+  ASSERT_EQ(0, fadeto(stdscr, COLORS, to, orig, 0));
+  ASSERT_EQ(0, outcurses_last_fade_stats(&stats));
+  check_fade_stats(stats);
+  EXPECT_EQ(1, stats.frames);
+  ASSERT_EQ(0, retrieve_palette(COLORS, cur, nullptr, false));
+  for(int i = 0 ; i < COLORS ; ++i){
+    EXPECT_EQ(orig[i].r, cur[i].r);
+    EXPECT_EQ(orig[i].g, cur[i].g);
+    EXPECT_EQ(orig[i].b, cur[i].b);
+  }
+  ASSERT_EQ(0, fadeto(stdscr, COLORS, orig, orig, 250)); // nothing to do
+  ASSERT_EQ(0, outcurses_stop(true));
+  delete[] cur;
+  delete[] to;
+  delete[] orig;
+}
+
+TEST(OutcursesFade, FadeAsync) {
+  if(getenv("TERM") == nullptr){
+	  GTEST_SKIP();
+  }
+  ASSERT_NE(nullptr, outcurses_init(true));
+  if(!can_change_color()){
+    outcurses_stop(true);
+    GTEST_SKIP();
+  }
+  outcurses_rgb* orig = new outcurses_rgb[COLORS];
+  outcurses_rgb* to = new outcurses_rgb[COLORS];
+  outcurses_rgb* cur = new outcurses_rgb[COLORS];
+  ASSERT_EQ(0, retrieve_palette(COLORS, orig, nullptr, false));
+  fade_setup(stdscr);
+  for(int i = 0 ; i < COLORS ; ++i){
+    to[i].r = orig[i].r / 2;
+    to[i].g = orig[i].g;
+    to[i].b = 1000 - orig[i].b;
+  }
+  struct fade* f = fade_start(stdscr, COLORS, nullptr, to, 250);
+  ASSERT_NE(nullptr, f);
+  struct pollfd pfd = { .fd = fade_fd(f), .events = POLLIN, .revents = 0, };
+  int steps = 0;
+  int r;
+  do{
+    ASSERT_EQ(1, poll(&pfd, 1, 1000));
+    ++steps;
+  }while((r = fade_step(f)) == 0);
+  ASSERT_EQ(1, r);
+  EXPECT_LT(1, steps);
+  outcurses_fade_stats stats;
+  fade_get_stats(f, &stats);
+  check_fade_stats(stats);
+  ASSERT_EQ(0, fade_destroy(f));
+  ASSERT_EQ(0, retrieve_palette(COLORS, cur, nullptr, false));
+  for(int i = 0 ; i < COLORS ; ++i){
+    EXPECT_EQ(to[i].r, cur[i].r);
+    EXPECT_EQ(to[i].g, cur[i].g);
+    EXPECT_EQ(to[i].b, cur[i].b);
+  }
+  // cancelling restores the palette from when the fade started
+  ASSERT_NE(nullptr, f = fade_start(stdscr, COLORS, to, orig, 1000));
+  pfd.fd = fade_fd(f);
+  ASSERT_EQ(1, poll(&pfd, 1, 1000));
+  ASSERT_EQ(0, fade_step(f));
+  ASSERT_EQ(0, fade_cancel(f));
+  ASSERT_EQ(0, retrieve_palette(COLORS, cur, nullptr, false));
+  for(int i = 0 ; i < COLORS ; ++i){
+    EXPECT_EQ(to[i].r, cur[i].r);
+    EXPECT_EQ(to[i].g, cur[i].g);
+    EXPECT_EQ(to[i].b, cur[i].b);
+  }
+  ASSERT_EQ(0, set_palette(COLORS, orig));
+  ASSERT_EQ(0, outcurses_stop(true));
+  delete[] cur;
+  delete[] to;
+  delete[] orig;
+}
+
+TEST(OutcursesFade, FadeRegion) {
+  if(getenv("TERM") == nullptr){
+	  GTEST_SKIP();
+  }
+  ASSERT_NE(nullptr, outcurses_init(true));
+  if(!can_change_color() || COLORS < 16){
+    outcurses_stop(true);
+    GTEST_SKIP();
+  }
+  outcurses_rgb* orig = new outcurses_rgb[COLORS];
+  outcurses_rgb* cur = new outcurses_rgb[COLORS];
+  ASSERT_EQ(0, retrieve_palette(COLORS, orig, nullptr, false));
+  // red is shared with stdscr, while 12 and 13 are only used in w
+  int red = COLOR_RED;
+  EXPECT_EQ(OK, wattr_set(stdscr, A_NORMAL, 0, &red));
+  EXPECT_EQ(OK, mvwprintw(stdscr, 0, 0, "outside"));
+  EXPECT_EQ(OK, wrefresh(stdscr));
+  WINDOW* w = newwin(4, 20, 2, 2);
+  ASSERT_NE(nullptr, w);
+  const int pairs[] = { red, outcurses_pair(12, 13), outcurses_pair(COLOR_RED, 12), };
+  for(int i = 0 ; i < 3 ; ++i){
+    ASSERT_LT(0, pairs[i]);
+    int pair = pairs[i];
+    EXPECT_EQ(OK, wattr_set(w, A_BOLD, 0, &pair));
+    EXPECT_EQ(OK, mvwprintw(w, i, 0, "inside %d", i));
+  }
+  ASSERT_EQ(0, fadein_region(w, 100));
+  ASSERT_EQ(0, fadeout_region(w, 100));
+  // the palette and w's cells are as they were
+  ASSERT_EQ(0, retrieve_palette(COLORS, cur, nullptr, false));
+  for(int i = 0 ; i < COLORS ; ++i){
+    EXPECT_EQ(orig[i].r, cur[i].r);
+    EXPECT_EQ(orig[i].g, cur[i].g);
+    EXPECT_EQ(orig[i].b, cur[i].b);
+  }
+  for(int i = 0 ; i < 3 ; ++i){
+    cchar_t c;
+    wchar_t wch[CCHARW_MAX + 1];
+    attr_t attrs;
+    short spair;
+    int pair;
+    ASSERT_EQ(OK, mvwin_wch(w, i, 1, &c));
+    ASSERT_EQ(OK, getcchar(&c, wch, &attrs, &spair, &pair));
+    EXPECT_EQ(pairs[i], pair);
+    EXPECT_EQ(A_BOLD, attrs & ~A_COLOR);
+  }
+  delwin(w);
+  outcurses_pair_release(pairs[1]);
+  outcurses_pair_release(pairs[2]);
+  ASSERT_EQ(0, outcurses_stop(true));
+  delete[] cur;
+  delete[] orig;
+}
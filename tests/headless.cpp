@@ -0,0 +1,113 @@
+#include "main.h"
+#include <vector>
+#include <cstring>
+
+// Headless mode doesn't need a real terminal, so these run even without TERM.
+
+TEST(Headless, InitStop) {
+  WINDOW* w = outcurses_init_headless("xterm-256color", 24, 80);
+  ASSERT_NE(nullptr, w);
+  EXPECT_EQ(24, getmaxy(w));
+  EXPECT_EQ(80, getmaxx(w));
+  ASSERT_EQ(0, outcurses_stop(true));
+  // no headless screen remains
+  EXPECT_EQ(-1, outcurses_headless_sample(nullptr));
+}
+
+// Output ought be reflected on the emulated screen, and counted.
+TEST(Headless, EmulatedScreen) {
+  WINDOW* w = outcurses_init_headless("xterm-256color", 24, 80);
+  ASSERT_NE(nullptr, w);
+  ASSERT_EQ(0, outcurses_headless_sample(nullptr));
+  const char msg[] = "headless";
+  mvwaddstr(w, 3, 5, msg);
+  wrefresh(w);
+  outcurses_termstats stats;
+  ASSERT_EQ(0, outcurses_headless_sample(&stats));
+  EXPECT_LT(0, stats.bytes);
+  EXPECT_LE(strlen(msg), stats.glyphs);
+  EXPECT_EQ(strlen(msg), stats.cells_changed);
+  for(size_t i = 0 ; i < strlen(msg) ; ++i){
+    wchar_t wc;
+    ASSERT_EQ(0, outcurses_headless_cell(3, 5 + i, &wc));
+    EXPECT_EQ(msg[i], wc);
+  }
+  // refreshing again without changes ought cost nothing
+  wrefresh(w);
+  ASSERT_EQ(0, outcurses_headless_sample(&stats));
+  EXPECT_EQ(0, stats.bytes);
+  EXPECT_EQ(0, stats.cells_changed);
+  wchar_t wc;
+  EXPECT_EQ(-1, outcurses_headless_cell(24, 0, &wc));
+  ASSERT_EQ(0, outcurses_stop(true));
+}
+
+// Erasure and colors ought be tracked through the emulator.
+TEST(Headless, EraseAndColor) {
+  WINDOW* w = outcurses_init_headless("xterm-256color", 10, 40);
+  ASSERT_NE(nullptr, w);
+  int pair = outcurses_pair(COLOR_RED, COLOR_BLUE);
+  ASSERT_LT(0, pair);
+  wattr_set(w, A_BOLD, pair, nullptr);
+  mvwaddstr(w, 0, 0, "abcdef");
+  wrefresh(w);
+  outcurses_termstats stats;
+  ASSERT_EQ(0, outcurses_headless_sample(&stats));
+  EXPECT_LT(0, stats.escapes);
+  werase(w);
+  wrefresh(w);
+  ASSERT_EQ(0, outcurses_headless_sample(&stats));
+  EXPECT_EQ(6, stats.cells_changed);
+  wchar_t wc;
+  ASSERT_EQ(0, outcurses_headless_cell(0, 0, &wc));
+  EXPECT_EQ(L' ', wc);
+  ASSERT_EQ(0, outcurses_stop(true));
+}
+
+// Palette writes go through the shadow palette, and are elided when they'd
+// change nothing.
+TEST(Headless, ShadowPalette) {
+  WINDOW* w = outcurses_init_headless("xterm-256color", 10, 40);
+  ASSERT_NE(nullptr, w);
+  if(!can_change_color()){
+    outcurses_stop(true);
+    GTEST_SKIP();
+  }
+  std::vector<outcurses_rgb> palette(COLORS);
+  ASSERT_EQ(0, retrieve_palette(COLORS, palette.data(), nullptr, false));
+  ASSERT_EQ(0, outcurses_headless_sample(nullptr));
+  const outcurses_rgb rgb = { .r = 100, .g = 200, .b = 300, };
+  ASSERT_EQ(0, outcurses_set_color(5, &rgb));
+  wrefresh(w);
+  outcurses_termstats stats;
+  ASSERT_EQ(0, outcurses_headless_sample(&stats));
+  EXPECT_LT(0, stats.escapes);
+  outcurses_rgb got;
+  ASSERT_EQ(0, retrieve_palette(6, palette.data(), &got, false));
+  EXPECT_EQ(rgb.r, palette[5].r);
+  EXPECT_EQ(rgb.g, palette[5].g);
+  EXPECT_EQ(rgb.b, palette[5].b);
+  // rewriting the same values costs nothing
+  ASSERT_EQ(0, outcurses_set_color(5, &rgb));
+  ASSERT_EQ(0, set_palette(6, palette.data()));
+  wrefresh(w);
+  ASSERT_EQ(0, outcurses_headless_sample(&stats));
+  EXPECT_EQ(0, stats.bytes);
+  EXPECT_EQ(-1, outcurses_set_color(-1, &rgb));
+  EXPECT_EQ(-1, outcurses_set_color(COLORS, &rgb));
+  ASSERT_EQ(0, outcurses_stop(true));
+}
+
+// A headless screen atop a real one ought leave the latter usable.
+TEST(Headless, AtopRealScreen) {
+  if(getenv("TERM") == nullptr){
+    GTEST_SKIP();
+  }
+  WINDOW* real = outcurses_init(true);
+  ASSERT_NE(nullptr, real);
+  ASSERT_NE(nullptr, outcurses_init_headless(nullptr, 24, 80));
+  ASSERT_EQ(0, outcurses_stop(true));
+  EXPECT_EQ(real, stdscr);
+  EXPECT_EQ(OK, wrefresh(real));
+  endwin();
+}
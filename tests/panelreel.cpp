@@ -1,5 +1,11 @@
 #include "main.h"
+#include <atomic>
 #include <iostream>
+#include <vector>
+#include <thread>
+#include <unistd.h>
+#include <sys/poll.h>
+#include <sys/eventfd.h>
 
 class PanelReelTest : public :: testing::Test {
   void SetUp() override {
@@ -241,3 +247,806 @@ TEST_F(PanelReelTest, SubwinNoOffsetGeom) {
   EXPECT_EQ(OK, delwin(basew));
   ASSERT_EQ(0, outcurses_stop(true));
 }
+
+// Counts its invocations (via the curry), and draws two lines.
+static int
+countcb(struct tablet* t, int begx, int begy, int maxx, int maxy,
+        bool cliptop){
+  (void)begx;
+  (void)maxx;
+  (void)cliptop;
+  ++*static_cast<int*>(tablet_userptr(t));
+  return maxy - begy + 1 < 2 ? maxy - begy + 1 : 2;
+}
+
+// Only touched tablets ought be redrawn by panelreel_update(), and an update
+// with nothing touched ought not invoke any callbacks.
+TEST_F(PanelReelTest, UpdateOnlyTouched) {
+  panelreel_options p{};
+  p.infinitescroll = true;
+  ASSERT_NE(nullptr, outcurses_init(true));
+  struct panelreel* pr = panelreel_create(stdscr, &p, -1);
+  ASSERT_NE(nullptr, pr);
+  int counts[3] = {};
+  struct tablet* ts[3];
+  for(int i = 0 ; i < 3 ; ++i){
+    ts[i] = panelreel_add(pr, nullptr, nullptr, countcb, &counts[i]);
+    ASSERT_NE(nullptr, ts[i]);
+  }
+  EXPECT_EQ(0, panelreel_validate(stdscr, pr));
+  for(auto& c : counts){
+    EXPECT_LT(0, c);
+    c = 0;
+  }
+  EXPECT_EQ(0, panelreel_update(pr));
+  EXPECT_EQ(0, counts[0] + counts[1] + counts[2]);
+  EXPECT_EQ(0, panelreel_touch(pr, ts[1]));
+  EXPECT_EQ(0, panelreel_update(pr));
+  EXPECT_EQ(0, counts[0]);
+  EXPECT_EQ(1, counts[1]);
+  EXPECT_EQ(0, counts[2]);
+  EXPECT_EQ(0, panelreel_validate(stdscr, pr));
+  // a full redraw invokes every visible callback
+  EXPECT_EQ(0, panelreel_redraw(pr));
+  EXPECT_EQ(1, counts[0]);
+  EXPECT_EQ(2, counts[1]);
+  EXPECT_EQ(1, counts[2]);
+  ASSERT_EQ(0, panelreel_destroy(pr));
+  ASSERT_EQ(0, outcurses_stop(true));
+}
+
+// Repeated touches ought coalesce into a single eventfd write, and a single
+// entry in the drained set.
+TEST_F(PanelReelTest, TouchesCoalesce) {
+  panelreel_options p{};
+  p.infinitescroll = true;
+  ASSERT_NE(nullptr, outcurses_init(true));
+  int efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  ASSERT_LE(0, efd);
+  struct panelreel* pr = panelreel_create(stdscr, &p, efd);
+  ASSERT_NE(nullptr, pr);
+  int counts[2] = {};
+  struct tablet* t0 = panelreel_add(pr, nullptr, nullptr, countcb, &counts[0]);
+  struct tablet* t1 = panelreel_add(pr, nullptr, nullptr, countcb, &counts[1]);
+  ASSERT_NE(nullptr, t0);
+  ASSERT_NE(nullptr, t1);
+  for(int i = 0 ; i < 100 ; ++i){
+    EXPECT_EQ(0, panelreel_touch(pr, t0));
+    EXPECT_EQ(0, panelreel_touch(pr, t1));
+  }
+  uint64_t val;
+  ASSERT_EQ(sizeof(val), read(efd, &val, sizeof(val)));
+  EXPECT_EQ(1, val);
+  struct tablet* drained[2];
+  ASSERT_EQ(1, panelreel_drain_touched(pr, drained, 1));
+  ASSERT_EQ(1, panelreel_drain_touched(pr, drained + 1, 1));
+  EXPECT_EQ(0, panelreel_drain_touched(pr, drained, 2));
+  EXPECT_TRUE((drained[0] == t0 && drained[1] == t1) ||
+              (drained[0] == t1 && drained[1] == t0));
+  // the drained tablets are still redrawn by the next update
+  counts[0] = counts[1] = 0;
+  EXPECT_EQ(0, panelreel_update(pr));
+  EXPECT_EQ(1, counts[0]);
+  EXPECT_EQ(1, counts[1]);
+  // having been consumed, a new touch wakes us up once more
+  EXPECT_EQ(0, panelreel_touch(pr, t1));
+  ASSERT_EQ(sizeof(val), read(efd, &val, sizeof(val)));
+  EXPECT_EQ(1, val);
+  // a pending tablet can be deleted
+  EXPECT_EQ(0, panelreel_del(pr, t1));
+  EXPECT_EQ(0, panelreel_drain_touched(pr, drained, 2));
+  ASSERT_EQ(0, panelreel_destroy(pr));
+  close(efd);
+  ASSERT_EQ(0, outcurses_stop(true));
+}
+
+// Once every tablet has been onscreen, scrolling ought recycle PANELs rather
+// than creating them. Tablets come from slabs.
+TEST_F(PanelReelTest, ScrollingRecyclesPanels) {
+  panelreel_options p{};
+  p.infinitescroll = true;
+  p.circular = true;
+  ASSERT_NE(nullptr, outcurses_init(true));
+  struct panelreel* pr = panelreel_create(stdscr, &p, -1);
+  ASSERT_NE(nullptr, pr);
+  int counts[100] = {};
+  for(auto& c : counts){
+    ASSERT_NE(nullptr, panelreel_add(pr, nullptr, nullptr, countcb, &c));
+  }
+  for(int i = 0 ; i < 100 ; ++i){
+    panelreel_next(pr);
+  }
+  panelreel_stats before;
+  panelreel_get_stats(pr, &before);
+  EXPECT_EQ(2, before.slab_misses);
+  EXPECT_EQ(98, before.slab_hits);
+  for(int i = 0 ; i < 200 ; ++i){
+    panelreel_next(pr);
+    EXPECT_EQ(0, panelreel_validate(stdscr, pr));
+  }
+  for(int i = 0 ; i < 200 ; ++i){
+    panelreel_prev(pr);
+  }
+  panelreel_stats after;
+  panelreel_get_stats(pr, &after);
+  EXPECT_EQ(before.pool_misses, after.pool_misses);
+  EXPECT_LT(before.pool_hits, after.pool_hits);
+  ASSERT_EQ(0, panelreel_destroy(pr));
+  ASSERT_EQ(0, outcurses_stop(true));
+}
+
+// Tablets paged offscreen keep their renderings in pads, and coming back
+// into view doesn't invoke their callbacks. A touch discards the pad.
+TEST_F(PanelReelTest, PadCache) {
+  panelreel_options p{};
+  p.infinitescroll = true;
+  p.circular = true;
+  ASSERT_NE(nullptr, outcurses_init(true));
+  struct panelreel* pr = panelreel_create(stdscr, &p, -1);
+  ASSERT_NE(nullptr, pr);
+  int counts[30] = {};
+  struct tablet* ts[30];
+  for(int i = 0 ; i < 30 ; ++i){
+    ASSERT_NE(nullptr, ts[i] = panelreel_add(pr, nullptr, nullptr, countcb, &counts[i]));
+  }
+  // paging down a lap renders every tablet, stashing those paged past
+  struct tablet* first = panelreel_focused(pr);
+  int pages = 0;
+  do{
+    ASSERT_NE(nullptr, panelreel_page_down(pr));
+    ++pages;
+  }while(panelreel_focused(pr) != first && pages < 30);
+  ASSERT_GT(30, pages);
+  panelreel_stats stats;
+  panelreel_get_stats(pr, &stats);
+  EXPECT_LT(0, stats.pad_bytes);
+  const unsigned long lap_callbacks = stats.callbacks;
+  const unsigned long lap_hits = stats.pad_hits;
+  // the second lap finds them coming back in from the bottom, as they left
+  for(int i = 0 ; i < pages ; ++i){
+    ASSERT_NE(nullptr, panelreel_page_down(pr));
+  }
+  EXPECT_EQ(0, panelreel_validate(stdscr, pr));
+  panelreel_get_stats(pr, &stats);
+  EXPECT_LT(lap_hits, stats.pad_hits);
+  EXPECT_GT(2 * lap_callbacks, stats.callbacks);
+  for(auto t : ts){
+    ASSERT_EQ(0, panelreel_touch(pr, t));
+  }
+  ASSERT_EQ(0, panelreel_update(pr));
+  panelreel_get_stats(pr, &stats);
+  EXPECT_EQ(0, stats.pad_bytes);
+  EXPECT_EQ(0, panelreel_validate(stdscr, pr));
+  ASSERT_EQ(0, panelreel_destroy(pr));
+  ASSERT_EQ(0, outcurses_stop(true));
+}
+
+// Labels each of three lines with the tablet's index (via the curry).
+static int
+labelcb(struct tablet* t, int begx, int begy, int maxx, int maxy,
+        bool cliptop){
+  (void)maxx;
+  (void)cliptop;
+  WINDOW* w = panel_window(tablet_panel(t));
+  int idx = *static_cast<int*>(tablet_userptr(t));
+  int y;
+  for(y = begy ; y <= maxy && y - begy < 3 ; ++y){
+    mvwprintw(w, y, begx, "tablet %d line %d", idx, y - begy);
+  }
+  return y - begy;
+}
+
+// Once the reel is full, a single step shifts most of the screen by a few
+// rows. ncurses ought send that as a terminal scroll, painting only what came
+// into view, rather than repainting every tablet which moved. This runs
+// headless, and thus even without TERM.
+TEST(PanelReelHeadless, SingleStepScrolls) {
+  panelreel_options p{};
+  p.infinitescroll = true;
+  p.circular = true;
+  WINDOW* w = outcurses_init_headless("xterm-256color", 40, 100);
+  ASSERT_NE(nullptr, w);
+  struct panelreel* pr = panelreel_create(w, &p, -1);
+  ASSERT_NE(nullptr, pr);
+  int idxs[40];
+  for(int i = 0 ; i < 40 ; ++i){
+    idxs[i] = i;
+    ASSERT_NE(nullptr, panelreel_add(pr, nullptr, nullptr, labelcb, &idxs[i]));
+  }
+  for(int i = 0 ; i < 20 ; ++i){ // move focus to the bottom of the screen
+    ASSERT_NE(nullptr, panelreel_next(pr));
+  }
+  outcurses_termstats ts;
+  ASSERT_EQ(0, outcurses_headless_sample(&ts));
+  for(int i = 0 ; i < 10 ; ++i){
+    ASSERT_NE(nullptr, panelreel_next(pr));
+    ASSERT_EQ(0, outcurses_headless_sample(&ts));
+    EXPECT_LT(ts.bytes, ts.cells_changed);
+  }
+  for(int i = 0 ; i < 20 ; ++i){
+    ASSERT_NE(nullptr, panelreel_prev(pr));
+  }
+  ASSERT_EQ(0, outcurses_headless_sample(&ts));
+  for(int i = 0 ; i < 10 ; ++i){
+    ASSERT_NE(nullptr, panelreel_prev(pr));
+    ASSERT_EQ(0, outcurses_headless_sample(&ts));
+    EXPECT_LT(ts.bytes, ts.cells_changed);
+  }
+  ASSERT_EQ(0, panelreel_destroy(pr));
+  ASSERT_EQ(0, outcurses_stop(true));
+}
+
+// Adds and deletions from other threads are only queued, waking the eventfd,
+// and are applied in order by the next panelreel_update().
+TEST_F(PanelReelTest, ThreadedProducers) {
+  panelreel_options p{};
+  p.infinitescroll = true;
+  p.circular = true;
+  ASSERT_NE(nullptr, outcurses_init(true));
+  int efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  ASSERT_LE(0, efd);
+  struct panelreel* pr = panelreel_create(stdscr, &p, efd);
+  ASSERT_NE(nullptr, pr);
+  int mycount = 0;
+  struct tablet* mine = panelreel_add(pr, nullptr, nullptr, countcb, &mycount);
+  ASSERT_NE(nullptr, mine);
+  const int THREADS = 4;
+  const int PERTHREAD = 32;
+  int counts[THREADS][PERTHREAD] = {};
+  std::vector<std::thread> producers;
+  for(int i = 0 ; i < THREADS ; ++i){
+    producers.emplace_back([pr, &counts, i]{
+      struct tablet* prev = nullptr;
+      for(int j = 0 ; j < PERTHREAD ; ++j){
+        struct tablet* t = panelreel_add(pr, prev, nullptr, countcb, &counts[i][j]);
+        ASSERT_NE(nullptr, t);
+        ASSERT_EQ(0, panelreel_touch(pr, t));
+        if(j % 2){ // delete every other one before it's ever applied
+          ASSERT_EQ(0, panelreel_del(pr, t));
+          EXPECT_EQ(-1, panelreel_del(pr, t));
+        }else{
+          prev = t;
+        }
+      }
+    });
+  }
+  for(auto& t : producers){
+    t.join();
+  }
+  // nothing has changed on our side yet
+  EXPECT_EQ(1, panelreel_tabletcount(pr));
+  struct pollfd pfd = { .fd = efd, .events = POLLIN, .revents = 0, };
+  ASSERT_EQ(1, poll(&pfd, 1, 0));
+  uint64_t val;
+  ASSERT_EQ(sizeof(val), read(efd, &val, sizeof(val)));
+  ASSERT_EQ(0, panelreel_update(pr));
+  EXPECT_EQ(1 + THREADS * PERTHREAD / 2, panelreel_tabletcount(pr));
+  EXPECT_EQ(0, panelreel_validate(stdscr, pr));
+  // each producer's survivors are contiguous, in the order they were added
+  for(int i = 0 ; i < THREADS ; ++i){
+    int first = -1;
+    for(int idx = 0 ; idx < panelreel_tabletcount(pr) ; ++idx){
+      if(tablet_userptr(panelreel_tablet_at(pr, idx)) == &counts[i][0]){
+        first = idx;
+      }
+    }
+    ASSERT_LE(0, first);
+    for(int j = 0 ; j < PERTHREAD ; j += 2){
+      struct tablet* t = panelreel_tablet_at(pr, first + j / 2);
+      ASSERT_NE(nullptr, t);
+      EXPECT_EQ(&counts[i][j], tablet_userptr(t));
+      EXPECT_EQ(0, counts[i][j + 1]); // never drawn
+    }
+  }
+  // a deletion from another thread is likewise queued
+  struct tablet* victim = panelreel_tablet_at(pr, 1);
+  ASSERT_NE(nullptr, victim);
+  std::thread deleter([pr, victim]{
+    EXPECT_EQ(0, panelreel_del(pr, victim));
+  });
+  deleter.join();
+  EXPECT_EQ(1 + THREADS * PERTHREAD / 2, panelreel_tabletcount(pr));
+  ASSERT_EQ(0, panelreel_update(pr));
+  EXPECT_EQ(THREADS * PERTHREAD / 2, panelreel_tabletcount(pr));
+  EXPECT_EQ(mine, panelreel_focused(pr));
+  EXPECT_LT(0, mycount);
+  EXPECT_EQ(0, panelreel_validate(stdscr, pr));
+  ASSERT_EQ(0, panelreel_destroy(pr));
+  close(efd);
+  ASSERT_EQ(0, outcurses_stop(true));
+}
+
+// Producers deleting their own adds while the owner is applying the queue
+// must neither lose other queued adds nor place tablets next to freed ones.
+TEST_F(PanelReelTest, ThreadedDeletesDuringUpdate) {
+  panelreel_options p{};
+  p.infinitescroll = true;
+  p.circular = true;
+  ASSERT_NE(nullptr, outcurses_init(true));
+  struct panelreel* pr = panelreel_create(stdscr, &p, -1);
+  ASSERT_NE(nullptr, pr);
+  int count = 0;
+  ASSERT_NE(nullptr, panelreel_add(pr, nullptr, nullptr, countcb, &count));
+  const int THREADS = 4;
+  const int PERTHREAD = 512;
+  std::atomic<int> survivors(0);
+  std::atomic<int> running(THREADS);
+  std::vector<std::thread> producers;
+  for(int i = 0 ; i < THREADS ; ++i){
+    producers.emplace_back([pr, &count, &survivors, &running]{
+      struct tablet* prev = nullptr;
+      for(int j = 0 ; j < PERTHREAD ; ++j){
+        struct tablet* t = panelreel_add(pr, prev, nullptr, countcb, &count);
+        if(t == nullptr){
+          ADD_FAILURE(); // don't return without decrementing running
+          break;
+        }
+        if(j % 3 == 1){ // delete it, whether or not its add was yet applied
+          EXPECT_EQ(0, panelreel_del(pr, t));
+        }else if(j % 3 == 2){ // replace our neighbor, maybe ahead of its add
+          EXPECT_EQ(0, panelreel_del(pr, prev));
+          prev = t;
+        }else{
+          ++survivors;
+          prev = t;
+        }
+      }
+      --running;
+    });
+  }
+  while(running){
+    ASSERT_EQ(0, panelreel_update(pr));
+  }
+  for(auto& t : producers){
+    t.join();
+  }
+  ASSERT_EQ(0, panelreel_update(pr));
+  EXPECT_EQ(1 + survivors, panelreel_tabletcount(pr));
+  EXPECT_EQ(0, panelreel_validate(stdscr, pr));
+  ASSERT_EQ(0, panelreel_destroy(pr));
+  ASSERT_EQ(0, outcurses_stop(true));
+}
+
+// An add queued relative to a tablet whose own add was cancelled, or which was
+// deleted earlier in the same batch, goes anywhere rather than next to it.
+TEST_F(PanelReelTest, QueuedAddAfterDeletedNeighbor) {
+  panelreel_options p{};
+  p.infinitescroll = true;
+  p.circular = true;
+  ASSERT_NE(nullptr, outcurses_init(true));
+  struct panelreel* pr = panelreel_create(stdscr, &p, -1);
+  ASSERT_NE(nullptr, pr);
+  int count = 0;
+  struct tablet* mine = panelreel_add(pr, nullptr, nullptr, countcb, &count);
+  ASSERT_NE(nullptr, mine);
+  struct tablet* linked = panelreel_add(pr, mine, nullptr, countcb, &count);
+  ASSERT_NE(nullptr, linked);
+  std::thread producer([pr, linked, &count]{
+    struct tablet* cancelled = panelreel_add(pr, nullptr, nullptr, countcb, &count);
+    ASSERT_NE(nullptr, cancelled);
+    ASSERT_EQ(0, panelreel_del(pr, cancelled));
+    EXPECT_NE(nullptr, panelreel_add(pr, cancelled, nullptr, countcb, &count));
+    ASSERT_EQ(0, panelreel_del(pr, linked));
+    EXPECT_NE(nullptr, panelreel_add(pr, nullptr, linked, countcb, &count));
+  });
+  producer.join();
+  ASSERT_EQ(0, panelreel_update(pr));
+  EXPECT_EQ(3, panelreel_tabletcount(pr));
+  EXPECT_EQ(0, panelreel_validate(stdscr, pr));
+  ASSERT_EQ(0, panelreel_destroy(pr));
+  ASSERT_EQ(0, outcurses_stop(true));
+}
+
+// The runtime counters ought agree with what the callbacks saw, and resetting
+// them ought leave only the gauge of window memory.
+TEST_F(PanelReelTest, RuntimeCounters) {
+  panelreel_options p{};
+  p.infinitescroll = true;
+  p.circular = true;
+  ASSERT_NE(nullptr, outcurses_init(true));
+  struct panelreel* pr = panelreel_create(stdscr, &p, -1);
+  ASSERT_NE(nullptr, pr);
+  int counts[30] = {};
+  struct tablet* ts[30];
+  for(int i = 0 ; i < 30 ; ++i){
+    ASSERT_NE(nullptr, ts[i] = panelreel_add(pr, nullptr, nullptr, countcb, &counts[i]));
+  }
+  panelreel_stats stats;
+  panelreel_get_stats(pr, &stats);
+  int calls = 0;
+  for(auto c : counts){
+    calls += c;
+  }
+  EXPECT_EQ(calls, stats.callbacks);
+  EXPECT_EQ(0, stats.measure_callbacks);
+  EXPECT_EQ(30, stats.arranges);
+  EXPECT_EQ(31, stats.frames); // creation draws the empty reel
+  EXPECT_EQ(stats.pool_misses, stats.panels_created);
+  EXPECT_LT(0, stats.window_bytes);
+  EXPECT_LE(stats.callback_ns, stats.arrange_ns);
+  EXPECT_EQ(0, stats.touches);
+  const unsigned long window_bytes = stats.window_bytes;
+  panelreel_reset_stats(pr);
+  panelreel_get_stats(pr, &stats);
+  EXPECT_EQ(0, stats.callbacks);
+  EXPECT_EQ(0, stats.arranges);
+  EXPECT_EQ(0, stats.arrange_ns);
+  EXPECT_EQ(window_bytes, stats.window_bytes);
+  for(int i = 0 ; i < 3 ; ++i){
+    ASSERT_EQ(0, panelreel_touch(pr, ts[0]));
+  }
+  ASSERT_EQ(0, panelreel_update(pr));
+  panelreel_get_stats(pr, &stats);
+  EXPECT_EQ(3, stats.touches);
+  EXPECT_EQ(1, stats.frames);
+  EXPECT_EQ(1, stats.arranges);
+  EXPECT_LT(0, stats.callbacks);
+  EXPECT_LT(0, stats.doupdate_ns);
+  for(int i = 0 ; i < 30 ; ++i){
+    panelreel_next(pr);
+  }
+  panelreel_get_stats(pr, &stats);
+  EXPECT_EQ(31, stats.arranges);
+  EXPECT_LT(0, stats.moves);
+  EXPECT_EQ(0, stats.panels_destroyed);
+  EXPECT_EQ(0, panelreel_validate(stdscr, pr));
+  ASSERT_EQ(0, panelreel_destroy(pr));
+  ASSERT_EQ(0, outcurses_stop(true));
+}
+
+// Tablets are indexed in reel order, however they were inserted, and focus can
+// jump anywhere without creating panels for the tablets in between.
+TEST_F(PanelReelTest, IndexedFocus) {
+  panelreel_options p{};
+  p.infinitescroll = true;
+  p.circular = true;
+  ASSERT_NE(nullptr, outcurses_init(true));
+  struct panelreel* pr = panelreel_create(stdscr, &p, -1);
+  ASSERT_NE(nullptr, pr);
+  EXPECT_EQ(-1, panelreel_focused_index(pr));
+  EXPECT_EQ(nullptr, panelreel_tablet_at(pr, 0));
+  const int count = 10000;
+  std::vector<int> counts(count + 1);
+  std::vector<struct tablet*> ts;
+  for(int i = 0 ; i < count ; ++i){
+    ts.push_back(panelreel_add(pr, nullptr, nullptr, countcb, &counts[i]));
+    ASSERT_NE(nullptr, ts.back());
+  }
+  EXPECT_EQ(0, panelreel_focused_index(pr));
+  for(int i = 0 ; i < count ; i += 997){
+    EXPECT_EQ(ts[i], panelreel_tablet_at(pr, i));
+  }
+  EXPECT_EQ(nullptr, panelreel_tablet_at(pr, count));
+  EXPECT_EQ(nullptr, panelreel_tablet_at(pr, -1));
+  // insert in the middle, moving everything after it back by one
+  struct tablet* mid = panelreel_add(pr, ts[4999], nullptr, countcb, &counts[count]);
+  ASSERT_NE(nullptr, mid);
+  EXPECT_EQ(mid, panelreel_tablet_at(pr, 5000));
+  EXPECT_EQ(ts[5000], panelreel_tablet_at(pr, 5001));
+  EXPECT_EQ(mid, panelreel_focus_index(pr, 5000));
+  EXPECT_EQ(5000, panelreel_focused_index(pr));
+  EXPECT_NE(nullptr, tablet_panel(mid));
+  EXPECT_EQ(nullptr, tablet_panel(ts[0]));
+  EXPECT_EQ(0, panelreel_validate(stdscr, pr));
+  EXPECT_EQ(ts[5000], panelreel_next(pr));
+  EXPECT_EQ(5001, panelreel_focused_index(pr));
+  EXPECT_EQ(0, panelreel_validate(stdscr, pr));
+  EXPECT_EQ(ts[count - 1], panelreel_focus_index(pr, count));
+  EXPECT_EQ(0, panelreel_validate(stdscr, pr));
+  EXPECT_EQ(nullptr, panelreel_focus_index(pr, count + 1));
+  EXPECT_EQ(count, panelreel_focused_index(pr));
+  panelreel_stats after;
+  panelreel_get_stats(pr, &after);
+  // a screen's worth of panels suffices, however far we jumped
+  EXPECT_GT(LINES, after.pool_misses);
+  ASSERT_EQ(0, panelreel_del(pr, mid));
+  EXPECT_EQ(ts[5000], panelreel_tablet_at(pr, 5000));
+  EXPECT_EQ(count - 1, panelreel_focused_index(pr));
+  ASSERT_EQ(0, panelreel_destroy(pr));
+  ASSERT_EQ(0, outcurses_stop(true));
+}
+
+struct measured {
+  int lines;   // reported by the measure callback
+  int draws;   // invocations of the draw callback
+  int rows;    // window height at the last draw
+  bool measuring; // the measure callback has been provided
+};
+
+static int
+measurecb(struct tablet* t, int cols){
+  (void)cols;
+  return static_cast<measured*>(tablet_userptr(t))->lines;
+}
+
+static int
+measureddrawcb(struct tablet* t, int begx, int begy, int maxx, int maxy,
+               bool cliptop){
+  (void)begx;
+  (void)maxx;
+  (void)cliptop;
+  auto m = static_cast<measured*>(tablet_userptr(t));
+  ++m->draws;
+  m->rows = getmaxy(panel_window(tablet_panel(t)));
+  if(!m->measuring){ // panelreel_add() draws before we can set measurecb
+    return m->lines < maxy - begy + 1 ? m->lines : maxy - begy + 1;
+  }
+  // we're never offered more than we asked for
+  EXPECT_GE(m->lines, maxy - begy + 1);
+  return maxy - begy + 1;
+}
+
+// Measured tablets are drawn into windows of their final size, and are only
+// redrawn when touched, however the reel moves.
+TEST_F(PanelReelTest, MeasuredTablets) {
+  panelreel_options p{};
+  p.infinitescroll = true;
+  p.circular = true;
+  ASSERT_NE(nullptr, outcurses_init(true));
+  struct panelreel* pr = panelreel_create(stdscr, &p, -1);
+  ASSERT_NE(nullptr, pr);
+  std::vector<measured> ms(40);
+  std::vector<struct tablet*> ts;
+  for(size_t i = 0 ; i < ms.size() ; ++i){
+    ms[i] = {2, 0, 0, false};
+    ts.push_back(panelreel_add(pr, nullptr, nullptr, measureddrawcb, &ms[i]));
+    ASSERT_NE(nullptr, ts.back());
+    ASSERT_EQ(0, panelreel_set_measurecb(pr, ts.back(), measurecb));
+    ms[i].measuring = true;
+    ASSERT_EQ(0, panelreel_update(pr));
+  }
+  EXPECT_EQ(0, panelreel_validate(stdscr, pr));
+  for(int i = 0 ; i < 100 ; ++i){
+    panelreel_next(pr);
+    EXPECT_EQ(0, panelreel_validate(stdscr, pr));
+    for(size_t j = 0 ; j < ts.size() ; ++j){
+      PANEL* tp = tablet_panel(ts[j]);
+      if(tp){
+        EXPECT_EQ(ms[j].rows, getmaxy(panel_window(tp)));
+      }
+    }
+  }
+  // growing a tablet redraws it, and only it
+  for(auto& m : ms){
+    m.draws = 0;
+  }
+  struct tablet* t = panelreel_focused(pr);
+  auto m = static_cast<measured*>(tablet_userptr(t));
+  m->lines += 3;
+  ASSERT_EQ(0, panelreel_touch(pr, t));
+  ASSERT_EQ(0, panelreel_update(pr));
+  EXPECT_EQ(1, m->draws);
+  EXPECT_EQ(m->rows, getmaxy(panel_window(tablet_panel(t))));
+  int draws = 0;
+  for(const auto& mm : ms){
+    draws += mm.draws;
+  }
+  EXPECT_GE(2, draws); // at most one more, clipped anew at the edge
+  EXPECT_EQ(0, panelreel_validate(stdscr, pr));
+  ASSERT_EQ(0, panelreel_destroy(pr));
+  ASSERT_EQ(0, outcurses_stop(true));
+}
+
+// Paging moves to the edge of the screen, and then a screenful at a time,
+// laying out once per page.
+TEST_F(PanelReelTest, PageNavigation) {
+  panelreel_options p{};
+  p.infinitescroll = true;
+  p.circular = true;
+  ASSERT_NE(nullptr, outcurses_init(true));
+  struct panelreel* pr = panelreel_create(stdscr, &p, -1);
+  ASSERT_NE(nullptr, pr);
+  EXPECT_EQ(nullptr, panelreel_page_down(pr));
+  EXPECT_EQ(nullptr, panelreel_page_up(pr));
+  int counts[100] = {};
+  for(auto& c : counts){
+    ASSERT_NE(nullptr, panelreel_add(pr, nullptr, nullptr, countcb, &c));
+  }
+  ASSERT_EQ(0, panelreel_focused_index(pr));
+  // every tablet occupies 4 rows, plus a gap, save perhaps one at the bottom
+  const int perpage = (LINES - 2 + 1) / 5;
+  ASSERT_LT(2, perpage);
+  ASSERT_NE(nullptr, panelreel_page_down(pr));
+  EXPECT_EQ(0, panelreel_validate(stdscr, pr));
+  int bottom = panelreel_focused_index(pr);
+  EXPECT_LE(perpage - 1, bottom);
+  EXPECT_GE(perpage, bottom);
+  for(int i = 0 ; i < 5 ; ++i){
+    for(auto& c : counts){
+      c = 0;
+    }
+    ASSERT_NE(nullptr, panelreel_page_down(pr));
+    EXPECT_EQ(0, panelreel_validate(stdscr, pr));
+    int idx = panelreel_focused_index(pr);
+    EXPECT_LE(bottom + perpage - 1, idx);
+    bottom = idx;
+    int calls = 0;
+    for(const auto& c : counts){
+      calls += c;
+    }
+    // one frame's worth of callbacks, rather than one per step
+    EXPECT_GE(perpage + 2, calls);
+  }
+  // the first page up moves to the top of the screen
+  ASSERT_NE(nullptr, panelreel_page_up(pr));
+  EXPECT_EQ(0, panelreel_validate(stdscr, pr));
+  int top = panelreel_focused_index(pr);
+  EXPECT_GT(bottom, top);
+  EXPECT_LE(bottom - perpage, top);
+  ASSERT_NE(nullptr, panelreel_page_up(pr));
+  EXPECT_EQ(0, panelreel_validate(stdscr, pr));
+  EXPECT_GT(top, panelreel_focused_index(pr));
+  struct tablet* t = panelreel_tablet_at(pr, 50);
+  EXPECT_EQ(t, panelreel_focus(pr, t));
+  EXPECT_EQ(50, panelreel_focused_index(pr));
+  EXPECT_EQ(0, panelreel_validate(stdscr, pr));
+  ASSERT_EQ(0, panelreel_destroy(pr));
+  ASSERT_EQ(0, outcurses_stop(true));
+}
+
+// A batch lays out the reel once, at its outermost commit.
+TEST_F(PanelReelTest, BatchedLoad) {
+  panelreel_options p{};
+  p.infinitescroll = true;
+  p.circular = true;
+  ASSERT_NE(nullptr, outcurses_init(true));
+  struct panelreel* pr = panelreel_create(stdscr, &p, -1);
+  ASSERT_NE(nullptr, pr);
+  EXPECT_EQ(-1, panelreel_commit(pr));
+  const int count = 20000;
+  std::vector<int> counts(count);
+  std::vector<void*> opaques;
+  for(auto& c : counts){
+    opaques.push_back(&c);
+  }
+  std::vector<struct tablet*> ts(count);
+  ASSERT_EQ(0, panelreel_begin_batch(pr));
+  ASSERT_EQ(count, panelreel_add_many(pr, nullptr, nullptr, countcb,
+                                      opaques.data(), count, ts.data()));
+  ASSERT_EQ(0, panelreel_commit(pr));
+  EXPECT_EQ(0, panelreel_validate(stdscr, pr));
+  EXPECT_EQ(count, panelreel_tabletcount(pr));
+  for(int i = 0 ; i < count ; i += 1999){
+    EXPECT_EQ(ts[i], panelreel_tablet_at(pr, i));
+  }
+  int calls = 0;
+  for(const auto& c : counts){
+    calls += c;
+  }
+  EXPECT_GT(LINES * 2, calls);
+  // after adds, in the same order
+  struct tablet* after = ts[count - 1];
+  ASSERT_EQ(2, panelreel_add_many(pr, after, nullptr, countcb,
+                                  opaques.data(), 2, ts.data()));
+  EXPECT_EQ(ts[0], panelreel_tablet_at(pr, count));
+  EXPECT_EQ(ts[1], panelreel_tablet_at(pr, count + 1));
+  ASSERT_EQ(0, panelreel_clear(pr));
+  EXPECT_EQ(0, panelreel_tabletcount(pr));
+  EXPECT_EQ(nullptr, panelreel_focused(pr));
+  EXPECT_EQ(0, panelreel_validate(stdscr, pr));
+  ASSERT_NE(nullptr, panelreel_add(pr, nullptr, nullptr, countcb, &counts[0]));
+  EXPECT_EQ(0, panelreel_validate(stdscr, pr));
+  ASSERT_EQ(0, panelreel_destroy(pr));
+  ASSERT_EQ(0, outcurses_stop(true));
+}
+
+static bool
+readable(int fd, int timeoutms){
+  struct pollfd pfd = { .fd = fd, .events = POLLIN, .revents = 0, };
+  return poll(&pfd, 1, timeoutms) == 1 && (pfd.revents & POLLIN);
+}
+
+TEST_F(PanelReelTest, ScheduledRendering) {
+  panelreel_options p{};
+  p.infinitescroll = true;
+  p.circular = true;
+  ASSERT_NE(nullptr, outcurses_init(true));
+  struct panelreel* pr = panelreel_create(stdscr, &p, -1);
+  ASSERT_NE(nullptr, pr);
+  struct panelreel_sched* sched = panelreel_sched_create(pr, 5);
+  ASSERT_NE(nullptr, sched);
+  EXPECT_EQ(nullptr, panelreel_sched_create(pr, 5));
+  int fd = panelreel_sched_fd(sched);
+  EXPECT_FALSE(readable(fd, 0)); // nothing to display
+  int counts[3] = {};
+  for(auto& c : counts){
+    ASSERT_NE(nullptr, panelreel_add(pr, nullptr, nullptr, countcb, &c));
+  }
+  // the last tablet isn't drawn until the scheduled frame
+  EXPECT_EQ(0, counts[2]);
+  ASSERT_TRUE(readable(fd, 1000));
+  ASSERT_EQ(0, panelreel_sched_run(sched));
+  EXPECT_EQ(0, panelreel_validate(stdscr, pr));
+  for(const auto& c : counts){
+    EXPECT_LT(0, c);
+  }
+  // idle: no wakeups, and running draws nothing
+  EXPECT_FALSE(readable(fd, 0));
+  int drawn = counts[0] + counts[1] + counts[2];
+  ASSERT_EQ(0, panelreel_sched_run(sched));
+  EXPECT_EQ(drawn, counts[0] + counts[1] + counts[2]);
+  // many operations within a frame are displayed together, no sooner than a
+  // frame interval after the last
+  for(int i = 0 ; i < 10 ; ++i){
+    EXPECT_NE(nullptr, panelreel_next(pr));
+  }
+  ASSERT_EQ(0, panelreel_touch(pr, panelreel_focused(pr)));
+  ASSERT_EQ(0, panelreel_update(pr));
+  EXPECT_EQ(drawn, counts[0] + counts[1] + counts[2]);
+  EXPECT_FALSE(readable(fd, 0));
+  ASSERT_TRUE(readable(fd, 1000));
+  ASSERT_EQ(0, panelreel_sched_run(sched));
+  EXPECT_LT(drawn, counts[0] + counts[1] + counts[2]);
+  EXPECT_EQ(0, panelreel_validate(stdscr, pr));
+  EXPECT_FALSE(readable(fd, 0));
+  ASSERT_EQ(0, panelreel_destroy(pr));
+  ASSERT_EQ(0, panelreel_sched_destroy(sched));
+  ASSERT_EQ(0, outcurses_stop(true));
+}
+
+// Resizing the reel's containing window resizes the reel in place. Tablets
+// whose width is unchanged aren't redrawn, and the focused tablet stays put.
+// This runs headless, and thus even without TERM.
+TEST(PanelReelHeadless, Resize) {
+  panelreel_options p{};
+  p.infinitescroll = true;
+  p.circular = true;
+  ASSERT_NE(nullptr, outcurses_init_headless("xterm-256color", 40, 100));
+  WINDOW* parent = newwin(30, 80, 0, 0);
+  ASSERT_NE(nullptr, parent);
+  struct panelreel* pr = panelreel_create(parent, &p, -1);
+  ASSERT_NE(nullptr, pr);
+  int counts[20] = {};
+  for(auto& c : counts){
+    ASSERT_NE(nullptr, panelreel_add(pr, nullptr, nullptr, countcb, &c));
+  }
+  for(int i = 0 ; i < 3 ; ++i){
+    ASSERT_NE(nullptr, panelreel_next(pr));
+  }
+  const int focusy = getbegy(panel_window(tablet_panel(panelreel_focused(pr))));
+  // unchanged, it's a no-op
+  ASSERT_EQ(0, panelreel_resize(pr, parent));
+  panelreel_stats stats;
+  panelreel_get_stats(pr, &stats);
+  EXPECT_EQ(0, stats.reel_resizes);
+  // taller: new tablets are drawn, but those already visible aren't
+  int before[20];
+  std::copy(counts, counts + 20, before);
+  ASSERT_EQ(OK, wresize(parent, 38, 80));
+  ASSERT_EQ(0, panelreel_resize(pr, parent));
+  EXPECT_EQ(0, panelreel_validate(parent, pr));
+  EXPECT_EQ(focusy, getbegy(panel_window(tablet_panel(panelreel_focused(pr)))));
+  EXPECT_EQ(before[3], counts[3]);
+  panelreel_get_stats(pr, &stats);
+  EXPECT_EQ(1, stats.reel_resizes);
+  // narrower: every visible tablet is drawn anew
+  std::copy(counts, counts + 20, before);
+  ASSERT_EQ(OK, wresize(parent, 38, 60));
+  ASSERT_EQ(0, panelreel_resize(pr, parent));
+  EXPECT_EQ(0, panelreel_validate(parent, pr));
+  EXPECT_EQ(focusy, getbegy(panel_window(tablet_panel(panelreel_focused(pr)))));
+  EXPECT_LT(before[3], counts[3]);
+  // a storm of resizes under a scheduler is laid out once, after it passes
+  struct panelreel_sched* sched = panelreel_sched_create(pr, 60);
+  ASSERT_NE(nullptr, sched);
+  int fd = panelreel_sched_fd(sched);
+  panelreel_reset_stats(pr);
+  for(int i = 0 ; i < 10 ; ++i){
+    ASSERT_EQ(OK, wresize(parent, 30 + i % 2 * 8, 60 + i % 3 * 10));
+    ASSERT_EQ(0, panelreel_resize(pr, parent));
+  }
+  panelreel_get_stats(pr, &stats);
+  EXPECT_EQ(10, stats.reel_resizes);
+  EXPECT_EQ(0, stats.arranges);
+  EXPECT_FALSE(readable(fd, 50)); // several frame intervals, but not quiet yet
+  ASSERT_TRUE(readable(fd, 1000));
+  ASSERT_EQ(0, panelreel_sched_run(sched));
+  panelreel_get_stats(pr, &stats);
+  EXPECT_EQ(1, stats.arranges);
+  EXPECT_EQ(0, panelreel_validate(parent, pr));
+  EXPECT_FALSE(readable(fd, 0));
+  ASSERT_EQ(0, panelreel_destroy(pr));
+  ASSERT_EQ(0, panelreel_sched_destroy(sched));
+  EXPECT_EQ(OK, delwin(parent));
+  ASSERT_EQ(0, outcurses_stop(true));
+}
@@ -0,0 +1,75 @@
+#include "main.h"
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// These run headless, and thus even without TERM.
+
+static int
+linecb(struct tablet* t, int begx, int begy, int maxx, int maxy,
+       bool cliptop){
+  (void)t;
+  (void)begx;
+  (void)maxx;
+  (void)cliptop;
+  return maxy - begy + 1 < 2 ? maxy - begy + 1 : 2;
+}
+
+static std::string
+dump_trace(int* events){
+  char* buf = nullptr;
+  size_t len = 0;
+  FILE* fp = open_memstream(&buf, &len);
+  if(fp == nullptr){
+    *events = -1;
+    return "";
+  }
+  *events = outcurses_trace_dump(fp);
+  fclose(fp);
+  std::string ret(buf, len);
+  free(buf);
+  return ret;
+}
+
+static int
+count_substr(const std::string& s, const std::string& sub){
+  int count = 0;
+  for(size_t pos = s.find(sub) ; pos != std::string::npos ; pos = s.find(sub, pos + 1)){
+    ++count;
+  }
+  return count;
+}
+
+// The dump is always a well-formed trace. If tracepoints were compiled in,
+// reel layout ought have left balanced spans.
+TEST(OutcursesTrace, ChromeJSON) {
+  outcurses_trace_clear();
+  WINDOW* w = outcurses_init_headless("xterm-256color", 24, 80);
+  ASSERT_NE(nullptr, w);
+  panelreel_options p{};
+  struct panelreel* pr = panelreel_create(w, &p, -1);
+  ASSERT_NE(nullptr, pr);
+  for(int i = 0 ; i < 5 ; ++i){
+    ASSERT_NE(nullptr, panelreel_add(pr, nullptr, nullptr, linecb, nullptr));
+  }
+  ASSERT_NE(nullptr, panelreel_next(pr));
+  ASSERT_EQ(0, panelreel_destroy(pr));
+  ASSERT_EQ(0, outcurses_stop(true));
+  int events;
+  std::string trace = dump_trace(&events);
+  ASSERT_LE(0, events);
+  EXPECT_EQ(0, trace.find("{\"traceEvents\":["));
+  EXPECT_EQ(trace.size() - 2, trace.rfind("}\n"));
+  EXPECT_EQ(events, count_substr(trace, "\"ph\":"));
+#ifdef OUTCURSES_TRACE
+  EXPECT_LT(0, events);
+  EXPECT_EQ(count_substr(trace, "\"ph\":\"B\""), count_substr(trace, "\"ph\":\"E\""));
+  EXPECT_LT(0, count_substr(trace, "\"name\":\"panelreel_arrange\""));
+  EXPECT_LT(0, count_substr(trace, "\"name\":\"panelreel_draw_tablet\""));
+#else
+  EXPECT_EQ(0, events);
+#endif
+  outcurses_trace_clear();
+  dump_trace(&events);
+  EXPECT_EQ(0, events);
+}